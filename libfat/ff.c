@@ -897,6 +897,14 @@ FRESULT put_fat (
 		res = FR_INT_ERR;
 
 	} else {
+#if _USE_FREEMAP
+		if (fs->fmap) {					/* Keep the free cluster bitmap in sync */
+			if (val & 0x0FFFFFFF)
+				fs->fmap[clst / 8] |= (BYTE)(1 << (clst % 8));
+			else
+				fs->fmap[clst / 8] &= (BYTE)~(1 << (clst % 8));
+		}
+#endif
 		switch (fs->fs_type) {
 		case FS_FAT12 :
 			bc = (UINT)clst; bc += bc / 2;
@@ -993,6 +1001,77 @@ FRESULT remove_chain (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Free cluster bitmap                                    */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_FREEMAP
+#define FMAP_RUN	16		/* Length of a free run preferred for new chains */
+
+static
+int build_fmap (	/* 0:Built, 1:Not enough core or disk error */
+	FATFS *fs		/* File system object */
+)
+{
+	DWORD clst, stat, size;
+
+
+	size = (fs->n_fatent + 7) / 8;
+	fs->fmap = ff_memalloc(size);
+	if (!fs->fmap) return 1;
+	mem_set(fs->fmap, 0, size);
+	fs->fmap[0] = 3;				/* Cluster 0 and 1 are not allocatable */
+
+	for (clst = 2; clst < fs->n_fatent; clst++) {
+		stat = get_fat(fs, clst);
+		if (stat == 0xFFFFFFFF || stat == 1) {
+			ff_memfree(fs->fmap);
+			fs->fmap = 0;
+			return 1;
+		}
+		if (stat) fs->fmap[clst / 8] |= (BYTE)(1 << (clst % 8));
+	}
+	return 0;
+}
+
+
+static
+DWORD find_free (	/* 0:No free cluster, >=2:Free cluster# */
+	FATFS *fs,		/* File system object */
+	DWORD scl,		/* Search starts next to this cluster */
+	int run			/* !=0: Prefer the top of a free run of FMAP_RUN clusters */
+)
+{
+	DWORD ncl, left, top = 0, len = 0, any = 0;
+
+
+	ncl = scl;
+	left = fs->n_fatent - 2;
+	while (left) {
+		if (++ncl >= fs->n_fatent) {	/* Wrap around */
+			ncl = 2; len = 0;
+		}
+		if (!(ncl % 8) && ncl + 8 <= fs->n_fatent && left >= 8 && fs->fmap[ncl / 8] == 0xFF) {
+			ncl += 7; left -= 8; len = 0;	/* Skip 8 clusters in use */
+			continue;
+		}
+		left--;
+		if (fs->fmap[ncl / 8] & (1 << (ncl % 8))) {
+			len = 0;
+			continue;
+		}
+		if (!run) return ncl;
+		if (!any) any = ncl;
+		if (!len++) top = ncl;
+		if (len >= FMAP_RUN) return top;
+	}
+	return any;
+}
+#endif	/* _USE_FREEMAP */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Stretch or Create a cluster chain                      */
 /*-----------------------------------------------------------------------*/
@@ -1018,6 +1097,13 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		scl = clst;
 	}
 
+#if _USE_FREEMAP
+	if (fs->fmap || !build_fmap(fs)) {	/* Search the bitmap */
+		ncl = find_free(fs, scl, clst == 0);
+		if (!ncl) return 0;				/* No free cluster */
+	} else
+#endif
+	{
 	ncl = scl;				/* Start cluster */
 	for (;;) {
 		ncl++;							/* Next cluster */
@@ -1031,6 +1117,7 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 			return cs;
 		if (ncl == scl) return 0;		/* No free cluster */
 	}
+	}
 
 	res = put_fat(fs, ncl, 0x0FFFFFFF);	/* Mark the new cluster "last link" */
 	if (res == FR_OK && clst != 0) {
@@ -2114,6 +2201,12 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 	/* Following code attempts to mount the volume. (analyze BPB and initialize the fs object) */
 
 	fs->fs_type = 0;					/* Clear the file system object */
+#if _USE_FREEMAP
+	if (fs->fmap) {						/* Discard the bitmap of the previous medium */
+		ff_memfree(fs->fmap);
+		fs->fmap = 0;
+	}
+#endif
 	fs->drv = LD2PD(vol);				/* Bind the logical drive and a physical drive */
 	stat = disk_initialize(fs->drv);	/* Initialize the physical drive */
 	if (stat & STA_NOINIT)				/* Check if the initialization succeeded */
@@ -2285,10 +2378,17 @@ FRESULT f_mount (
 		if (!ff_del_syncobj(rfs->sobj)) return FR_INT_ERR;
 #endif
 		rfs->fs_type = 0;		/* Clear old fs object */
+#if _USE_FREEMAP
+		if (rfs->fmap) ff_memfree(rfs->fmap);
+		rfs->fmap = 0;
+#endif
 	}
 
 	if (fs) {
 		fs->fs_type = 0;		/* Clear new fs object */
+#if _USE_FREEMAP
+		fs->fmap = 0;
+#endif
 #if _FS_REENTRANT				/* Create sync object for the new volume */
 		if (!ff_cre_syncobj(vol, &fs->sobj)) return FR_INT_ERR;
 #endif
@@ -3136,10 +3236,13 @@ FRESULT f_stat (
 		INIT_BUF(dj);
 		res = follow_path(&dj, path);	/* Follow the file path */
 		if (res == FR_OK) {				/* Follow completed */
-			if (dj.dir)		/* Found an object */
+			if (dj.dir) {	/* Found an object */
 				get_fileinfo(&dj, fno);
-			else			/* It is root dir */
+				fno->dsect = dj.fs->winsect;
+				fno->dindex = (UINT)(dj.dir - dj.fs->win) / SZ_FDIR;
+			} else {		/* It is root dir */
 				res = FR_INVALID_NAME;
+			}
 		}
 		FREE_BUF();
 	}
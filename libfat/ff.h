@@ -105,6 +105,9 @@ typedef struct {
 	DWORD	dirbase;		/* Root directory start sector (FAT32:Cluster#) */
 	DWORD	database;		/* Data start sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
+#if _USE_FREEMAP
+	BYTE*	fmap;			/* Free cluster bitmap (1:In use, null until built) */
+#endif
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and Data on tiny cfg) */
 } FATFS;
 
@@ -170,6 +173,8 @@ typedef struct {
 	TCHAR*	lfname;			/* Pointer to the LFN buffer */
 	UINT 	lfsize;			/* Size of LFN buffer in TCHAR */
 #endif
+	DWORD	dsect;			/* Sector containing the directory entry (f_stat only) */
+	UINT	dindex;			/* Index of the directory entry in that sector (f_stat only) */
 } FILINFO;
 
 
@@ -258,11 +263,11 @@ DWORD get_fattime (void);
 #if _USE_LFN							/* Unicode - OEM code conversion */
 WCHAR ff_convert (WCHAR chr, UINT dir);	/* OEM-Unicode bidirectional conversion */
 WCHAR ff_wtoupper (WCHAR chr);			/* Unicode upper-case conversion */
-#if _USE_LFN == 3						/* Memory functions */
+#endif
+#if _USE_LFN == 3 || _USE_FREEMAP		/* Memory functions */
 void* ff_memalloc (UINT msize);			/* Allocate memory block */
 void ff_memfree (void* mblock);			/* Free memory block */
 #endif
-#endif
 
 /* Sync functions */
 #if _FS_REENTRANT
@@ -24,6 +24,10 @@ Copyright (c) 2004 Bruno T. C. de Oliveira
 #include "inject_csi.h"
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 static void cursor_line_down(RoteTerm *rt) {
    int i;
    rt->crow++;
@@ -88,6 +92,37 @@ static inline void put_normal_char(RoteTerm *rt, char c) {
    rt->curpos_dirty = true;
 }
 
+/* Writes a run of printable characters (see printable_run_length) at the
+ * cursor, a row segment at a time, with the same wrapping behaviour as
+ * calling put_normal_char for each of them. */
+static void put_normal_run(RoteTerm *rt, const char *data, int len) {
+   int i, n;
+   RoteCell *cell;
+
+   while (len > 0) {
+      if (rt->ccol >= rt->cols) {
+         rt->ccol = 0;
+         cursor_line_down(rt);
+      }
+
+      n = rt->cols - rt->ccol;
+      if (n > len) n = len;
+
+      cell = &rt->cells[rt->crow][rt->ccol];
+      for (i = 0; i < n; i++) {
+         cell[i].ch = data[i];
+         cell[i].attr = rt->curattr;
+      }
+
+      rt->ccol += n;
+      rt->line_dirty[rt->crow] = true;
+      data += n;
+      len -= n;
+   }
+
+   rt->curpos_dirty = true;
+}
+
 static inline void put_graphmode_char(RoteTerm *rt, char c) {
    char nc;
    /* do some very pitiful translation to regular ascii chars */
@@ -241,9 +276,43 @@ static void try_interpret_escape_seq(RoteTerm *rt) {
    if (rt->pd->esbuf_len + 1 >= ESEQ_BUF_SIZE) cancel_escape_sequence(rt);
 }
    
+/* Returns the number of leading bytes of data that are neither NUL nor
+ * control characters (that is, bytes >= 32, which put_normal_char would
+ * print as-is) */
+static int printable_run_length(const char *data, int len) {
+   int i = 0;
+
+#ifdef __SSE2__
+   const __m128i space = _mm_set1_epi8(0x20);
+   for (; i + 16 <= len; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+      /* max(v, 0x20) == v exactly for the bytes >= 0x20 */
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, space), v));
+      if (mask != 0xFFFF)
+         return i + __builtin_ctz(~mask);
+   }
+#endif
+
+   for (; i < len; i++)
+      if ((unsigned char)data[i] < 0x20) break;
+   return i;
+}
+
 void rote_vt_inject(RoteTerm *rt, const char *data, int len) {
-   int i;
-   for (i = 0; i < len; i++, data++) {
+   const char *end = data + len;
+   int run;
+
+   for (; data < end; data++) {
+      if (!rt->pd->escaped && !rt->pd->graphmode) {
+         /* fast path: plain text goes straight into the cell rows */
+         run = printable_run_length(data, end - data);
+         if (run > 0) {
+            put_normal_run(rt, data, run);
+            data += run - 1;
+            continue;
+         }
+      }
+
       if (*data == 0) continue;  /* completely ignore NUL */
       if (*data >= 1 && *data <= 31) {
          handle_control_char(rt, *data);
@@ -29,9 +29,14 @@ Copyright (c) 2004 Bruno T. C. de Oliveira
 #ifndef btco_ROTE_rote_h
 #define btco_ROTE_rote_h
 
+/* C++ has a native (1-byte) bool; the library is built as C with an int
+ * bool, so the public structures use rote_bool to keep one layout */
+#ifndef __cplusplus
 typedef int bool ;
 #define true 1
 #define false 0
+#endif
+typedef int rote_bool ;
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -132,8 +137,8 @@ typedef struct RoteTerm_ {
    /* --- dirtiness flags: the following flags will be raised when the
     * corresponding items are modified. They can only be unset by YOU
     * (when, for example, you redraw the term or something) --- */
-   bool curpos_dirty;           /* whether cursor location has changed */
-   bool *line_dirty;            /* whether each row is dirty  */
+   rote_bool curpos_dirty;      /* whether cursor location has changed */
+   rote_bool *line_dirty;       /* whether each row is dirty  */
    /* --- end dirtiness flags */
 } RoteTerm;
 
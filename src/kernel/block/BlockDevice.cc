@@ -0,0 +1,267 @@
+#include <block/BlockDevice.h>
+#include <core/Scheduler.h>
+#include <core/Thread.h>
+#include <core/Wait.h>
+#include <hardware/pit/PIT.h>
+#include <memory/AddressSpace.h>
+#include <memory/Memory.h>
+#include <kconfig.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+
+BlockDevice* BlockDevice::devices = NULL;
+
+
+void block_request_init(block_request_t* r, int op, uint64_t sector, uint32_t count, void* buffer) {
+    memset(r, 0, sizeof(block_request_t));
+    r->op = op;
+    r->sector = sector;
+    r->count = count;
+    r->buffer = (uint8_t*)buffer;
+}
+
+uint64_t block_request_physical(block_request_t* r, uint64_t offset) {
+    uint64_t virt = (uint64_t)r->buffer + offset;
+    return r->pages[(virt - PAGEALIGN(r->buffer)) / KCFG_PAGE_SIZE] + virt % KCFG_PAGE_SIZE;
+}
+
+
+BlockDevice::BlockDevice(const char* n, uint64_t s) {
+    strncpy(name, n, sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+    sectors = s;
+    queueDepth = 1;
+    maxSegments = 0;
+    parent = NULL;
+    memset(&stats, 0, sizeof(stats));
+    queue = NULL;
+    fifo[BLOCK_READ] = fifo[BLOCK_WRITE] = NULL;
+    headPosition = 0;
+    inFlight = 0;
+    kicking = false;
+
+    // Registration order puts partitions right after their disk
+    next = NULL;
+    BlockDevice** p = &devices;
+    while (*p)
+        p = &(*p)->next;
+    *p = this;
+}
+
+void BlockDevice::submit(block_request_t* r) {
+    if (!r->count || r->count > KCFG_BLOCK_MAX_SECTORS || r->sector + r->count > sectors) {
+        fail(r, EIO);
+        return;
+    }
+    resolve(r);
+
+    uint64_t now = PIT::get()->getTime();
+    r->deadline = now + ((r->op == BLOCK_READ) ? KCFG_BLOCK_READ_EXPIRE_MS : KCFG_BLOCK_WRITE_EXPIRE_MS);
+    r->totalCount = r->count;
+    r->segmentCount = 1;
+    r->nextSegment = NULL;
+    r->lastSegment = r;
+    r->status = 0;
+    r->done = false;
+    startIO(r);
+
+    if (!merge(r)) {
+        block_request_t** p = &queue;
+        while (*p && (*p)->sector <= r->sector)
+            p = &(*p)->next;
+        r->next = *p;
+        *p = r;
+
+        p = &fifo[r->op];
+        while (*p)
+            p = &(*p)->fifoNext;
+        r->fifoNext = NULL;
+        *p = r;
+    }
+    kick();
+}
+
+bool BlockDevice::merge(block_request_t* r) {
+    for (block_request_t* q = queue; q; q = q->next)
+        if (q->op == r->op && q->sector + q->totalCount == r->sector
+            && q->totalCount + r->count <= KCFG_BLOCK_MAX_SECTORS
+            && (!maxSegments || q->segmentCount < maxSegments)) {
+            q->lastSegment->nextSegment = r;
+            q->lastSegment = r;
+            q->totalCount += r->count;
+            q->segmentCount++;
+            stats.merges[r->op]++;
+            return true;
+        }
+    return false;
+}
+
+block_request_t* BlockDevice::pick() {
+    uint64_t now = PIT::get()->getTime();
+    block_request_t* r = NULL;
+    for (int op = BLOCK_READ; op <= BLOCK_WRITE && !r; op++)
+        if (fifo[op] && fifo[op]->deadline <= now)
+            r = fifo[op];
+
+    // Nothing expired: carry on up the disk from the last request,
+    // and start over from the lowest sector at the top
+    if (!r) {
+        r = queue;
+        while (r && r->sector < headPosition)
+            r = r->next;
+        if (!r)
+            r = queue;
+    }
+
+    block_request_t** p = &queue;
+    while (*p != r)
+        p = &(*p)->next;
+    *p = r->next;
+    p = &fifo[r->op];
+    while (*p != r)
+        p = &(*p)->fifoNext;
+    *p = r->fifoNext;
+    return r;
+}
+
+void BlockDevice::kick() {
+    // Drivers that finish inside dispatch() come back here through
+    // complete(); the outermost call does the dispatching
+    if (kicking)
+        return;
+    kicking = true;
+    while (queue && inFlight < queueDepth) {
+        block_request_t* r = pick();
+        headPosition = r->sector + r->totalCount;
+        inFlight++;
+        dispatch(r);
+    }
+    kicking = false;
+}
+
+void BlockDevice::complete(block_request_t* r, int status) {
+    inFlight--;
+    while (r) {
+        // The callback may reuse the request
+        block_request_t* next = r->nextSegment;
+        endIO(r, r->count);
+        if (r->partition)
+            r->partition->endIO(r, r->count);
+        r->status = status;
+        r->done = true;
+        if (r->callback)
+            r->callback(r);
+        r = next;
+    }
+    kick();
+}
+
+void BlockDevice::fail(block_request_t* r, int status) {
+    r->status = status;
+    r->done = true;
+    if (r->callback)
+        r->callback(r);
+}
+
+void BlockDevice::resolve(block_request_t* r) {
+    // Drivers may start the request from an interrupt, under whatever
+    // address space happens to be loaded then
+    uint64_t first = PAGEALIGN(r->buffer);
+    uint64_t count = (PAGECEIL(r->buffer + (uint64_t)r->count * 512) - first) / KCFG_PAGE_SIZE;
+    for (uint64_t i = 0; i < count; i++)
+        r->pages[i] = Memory::getPhysical((void*)(first + i * KCFG_PAGE_SIZE));
+}
+
+void BlockDevice::startIO(block_request_t* r) {
+    updateBusy();
+    stats.inFlight++;
+    r->submitted = PIT::get()->getTime();
+}
+
+void BlockDevice::endIO(block_request_t* r, uint32_t count) {
+    updateBusy();
+    stats.inFlight--;
+    stats.ops[r->op]++;
+    stats.sectors[r->op] += count;
+    stats.ticks[r->op] += PIT::get()->getTime() - r->submitted;
+}
+
+void BlockDevice::updateBusy() {
+    uint64_t now = PIT::get()->getTime();
+    if (stats.inFlight)
+        stats.ioTicks += now - stats.busySince;
+    stats.busySince = now;
+}
+
+void BlockDevice::poll() {
+}
+
+void BlockDevice::wait(block_request_t* r) {
+    // Sleeping resumes the scheduler, put it back the way the caller had it
+    Scheduler* scheduler = Scheduler::get();
+    while (!r->done) {
+        Thread* thread = scheduler->getActiveThread();
+        bool paused = !scheduler->active;
+
+        thread->wait(new WaitForBlock(r, this));
+        thread->stopWaiting();
+
+        if (paused)
+            scheduler->pause();
+    }
+}
+
+int BlockDevice::transfer(int op, uint64_t sector, uint32_t count, uint8_t* buffer) {
+    // Not on the stack: the caller's stack is only mapped in its own
+    // address space, and completion can come from any context
+    block_request_t* r = new block_request_t();
+    int status = 0;
+    while (count && !status) {
+        uint32_t c = (count < KCFG_BLOCK_MAX_SECTORS) ? count : KCFG_BLOCK_MAX_SECTORS;
+        block_request_init(r, op, sector, c, buffer);
+        submit(r);
+        wait(r);
+        status = r->status;
+        sector += c;
+        count -= c;
+        buffer += (uint64_t)c * 512;
+    }
+    delete r;
+    return status;
+}
+
+int BlockDevice::read(uint64_t sector, uint32_t count, void* buffer) {
+    return transfer(BLOCK_READ, sector, count, (uint8_t*)buffer);
+}
+
+int BlockDevice::write(uint64_t sector, uint32_t count, const void* buffer) {
+    return transfer(BLOCK_WRITE, sector, count, (uint8_t*)buffer);
+}
+
+BlockDevice* BlockDevice::find(const char* name) {
+    for (BlockDevice* d = devices; d; d = d->next)
+        if (strcmp(d->name, name) == 0)
+            return d;
+    return NULL;
+}
+
+uint64_t BlockDevice::renderStats(char* buffer, uint64_t size) {
+    // Same columns as Linux /proc/diskstats, up to io_ticks
+    uint64_t used = 0;
+    int minor = 0;
+    for (BlockDevice* d = devices; d; d = d->next, minor++) {
+        char line[256];
+        int len = snprintf(line, 256, "%4i %7i %s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu\n",
+            0, minor, d->name,
+            d->stats.ops[BLOCK_READ], d->stats.merges[BLOCK_READ], d->stats.sectors[BLOCK_READ], d->stats.ticks[BLOCK_READ],
+            d->stats.ops[BLOCK_WRITE], d->stats.merges[BLOCK_WRITE], d->stats.sectors[BLOCK_WRITE], d->stats.ticks[BLOCK_WRITE],
+            d->stats.inFlight, d->stats.ioTicks);
+        if (len <= 0 || used + len > size)
+            break;
+        memcpy(buffer + used, line, len);
+        used += len;
+    }
+    return used;
+}
@@ -0,0 +1,115 @@
+#ifndef BLOCK_BLOCKDEVICE_H
+#define BLOCK_BLOCKDEVICE_H
+
+#include <lang/lang.h>
+#include <kconfig.h>
+
+
+#define BLOCK_READ 0
+#define BLOCK_WRITE 1
+
+// Pages a request of KCFG_BLOCK_MAX_SECTORS can touch at any alignment
+#define BLOCK_REQUEST_PAGES (KCFG_BLOCK_MAX_SECTORS * 512 / KCFG_PAGE_SIZE + 1)
+
+
+class BlockDevice;
+
+struct block_request_t;
+typedef void (*block_callback_t)(block_request_t*);
+
+struct block_request_t {
+    int op;
+    uint64_t sector;
+    uint32_t count;
+    uint8_t* buffer;
+    // Physical address of each page the buffer touches, looked up by
+    // submit() while the submitter's address space is loaded. Kept
+    // inline so completion never has to touch the heap
+    uint64_t pages[BLOCK_REQUEST_PAGES];
+
+    // Set on completion: status is 0 or an errno value
+    int status;
+    volatile bool done;
+    block_callback_t callback;
+    void* context;
+
+    // Queue bookkeeping. A request that others were merged into
+    // carries them on nextSegment, in sector order; drivers transfer
+    // every segment and complete the head only
+    uint64_t submitted;
+    uint64_t deadline;
+    uint32_t totalCount;
+    uint32_t segmentCount;
+    block_request_t* next;
+    block_request_t* fifoNext;
+    block_request_t* nextSegment;
+    block_request_t* lastSegment;
+    BlockDevice* partition;
+};
+
+void block_request_init(block_request_t* r, int op, uint64_t sector, uint32_t count, void* buffer);
+// Physical address of the byte at offset in a submitted request's buffer
+uint64_t block_request_physical(block_request_t* r, uint64_t offset);
+
+
+struct block_stats_t {
+    uint64_t ops[2];
+    uint64_t merges[2];
+    uint64_t sectors[2];
+    uint64_t ticks[2];
+    uint64_t inFlight;
+    uint64_t ioTicks;
+    uint64_t busySince;
+};
+
+
+// A disk or a piece of one. Requests are queued sorted by sector and
+// dispatched in one direction across the disk, except that a read
+// older than KCFG_BLOCK_READ_EXPIRE_MS or a write older than
+// KCFG_BLOCK_WRITE_EXPIRE_MS goes first. A request that continues a
+// queued one is merged into it
+class BlockDevice {
+public:
+    BlockDevice(const char* name, uint64_t sectors);
+    virtual void submit(block_request_t* r);
+    void wait(block_request_t* r);
+    int read(uint64_t sector, uint32_t count, void* buffer);
+    int write(uint64_t sector, uint32_t count, const void* buffer);
+    // Checks for finished requests; called while a thread waits on
+    // one, for drivers that run without an interrupt
+    virtual void poll();
+
+    static BlockDevice* find(const char* name);
+    static uint64_t renderStats(char* buffer, uint64_t size);
+    static BlockDevice* devices;
+
+    char name[16];
+    uint64_t sectors;
+    uint32_t queueDepth;
+    uint32_t maxSegments;
+    BlockDevice* parent;
+    block_stats_t stats;
+    BlockDevice* next;
+protected:
+    // Starts a request, which may carry merged segments. Drivers call
+    // complete() when it is done, from any context
+    virtual void dispatch(block_request_t* r) = 0;
+    void complete(block_request_t* r, int status);
+    void startIO(block_request_t* r);
+    void endIO(block_request_t* r, uint32_t sectors);
+    void fail(block_request_t* r, int status);
+private:
+    int transfer(int op, uint64_t sector, uint32_t count, uint8_t* buffer);
+    bool merge(block_request_t* r);
+    block_request_t* pick();
+    void kick();
+    void updateBusy();
+    static void resolve(block_request_t* r);
+    block_request_t* queue;
+    block_request_t* fifo[2];
+    uint64_t headPosition;
+    uint32_t inFlight;
+    bool kicking;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <block/Partition.h>
+#include <alloc/malloc.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <kutil.h>
+
+
+#define MBR_TABLE 446
+#define MBR_ENTRIES 4
+
+
+Partition::Partition(BlockDevice* disk, int index, uint64_t s, uint64_t count) : BlockDevice("", count) {
+    // nvme0n1 has partitions nvme0n1p1 and so on
+    int length = strlen(disk->name);
+    bool digit = length && disk->name[length - 1] >= '0' && disk->name[length - 1] <= '9';
+    snprintf(name, sizeof(name), digit ? "%sp%i" : "%s%i", disk->name, index);
+    parent = disk;
+    start = s;
+}
+
+void Partition::submit(block_request_t* r) {
+    if (!r->count || r->sector + r->count > sectors) {
+        fail(r, EIO);
+        return;
+    }
+    startIO(r);
+    r->partition = this;
+    r->sector += start;
+    parent->submit(r);
+}
+
+void Partition::poll() {
+    parent->poll();
+}
+
+void Partition::dispatch(block_request_t* r) {
+    // Never queued here, submit() hands everything to the disk
+}
+
+int Partition::scan(BlockDevice* disk) {
+    uint8_t* mbr = (uint8_t*)kmalloc(512);
+    int found = 0;
+
+    // A FAT boot sector carries the same signature as an MBR
+    bool valid = disk->read(0, 1, mbr) == 0 && mbr[510] == 0x55 && mbr[511] == 0xaa
+        && memcmp(mbr + 0x36, "FAT", 3) && memcmp(mbr + 0x52, "FAT", 3);
+
+    for (int i = 0; valid && i < MBR_ENTRIES; i++) {
+        uint8_t* entry = mbr + MBR_TABLE + 16 * i;
+        uint64_t lba = *(uint32_t*)(entry + 8);
+        uint64_t count = *(uint32_t*)(entry + 12);
+        if (!entry[4] || !lba || !count || lba + count > disk->sectors)
+            continue;
+        Partition* p = new Partition(disk, i + 1, lba, count);
+        klog('i', "Partition %s: type %02x, %lu sectors at %lu", p->name, entry[4], count, lba);
+        found++;
+    }
+
+    kfree(mbr);
+    return found;
+}
@@ -0,0 +1,25 @@
+#ifndef BLOCK_PARTITION_H
+#define BLOCK_PARTITION_H
+
+#include <block/BlockDevice.h>
+
+
+// A range of sectors on a disk. Requests are shifted into place and
+// queued on the disk, so they merge and get scheduled with everything
+// else that goes to it
+class Partition : public BlockDevice {
+public:
+    Partition(BlockDevice* disk, int index, uint64_t start, uint64_t sectors);
+    virtual void submit(block_request_t* r);
+    virtual void poll();
+
+    // Registers a Partition for every entry in the disk's MBR and
+    // returns how many there were
+    static int scan(BlockDevice* disk);
+
+    uint64_t start;
+protected:
+    virtual void dispatch(block_request_t* r);
+};
+
+#endif
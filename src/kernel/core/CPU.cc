@@ -58,6 +58,17 @@ void CPU::invalidateTLB(uint64_t v) {
 }
 
 
+uint64_t CPU::RDTSC() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint32_t CPU::getID() {
+    return 0; // only the BSP is brought up
+}
+
+
 void CPU::CLI() {
     asm volatile("cli");
 }
@@ -28,6 +28,8 @@ public:
     static void     halt();
     static void     enableSSE();
     static void     invalidateTLB(uint64_t);
+    static uint64_t RDTSC();
+    static uint32_t getID();
 
     static uint64_t RDMSR(uint32_t msr_id);
     static void     WRMSR(uint32_t msr_id, uint64_t msr_value);
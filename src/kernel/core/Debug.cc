@@ -58,6 +58,12 @@ void Debug::onDumpTasks(void*) {
                 CHECK_WAIT(WAIT_FOR_DELAY);
                 CHECK_WAIT(WAIT_FOR_CHILD);
                 CHECK_WAIT(WAIT_FOR_FILE);
+                CHECK_WAIT(WAIT_FOR_EPOLL);
+                CHECK_WAIT(WAIT_FOR_POLL);
+                CHECK_WAIT(WAIT_FOR_IORING);
+                CHECK_WAIT(WAIT_FOR_MUTEX);
+                CHECK_WAIT(WAIT_FOR_WRITEBACK);
+                CHECK_WAIT(WAIT_FOR_BLOCK);
             } else 
                 st = "running";
             klog('i', " - TID %3i %10s | %15s | %4i cycles", 
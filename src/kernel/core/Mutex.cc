@@ -0,0 +1,41 @@
+#include <core/Mutex.h>
+#include <core/Scheduler.h>
+#include <core/Thread.h>
+#include <core/Wait.h>
+
+
+Mutex::Mutex() {
+    owner = NULL;
+    locked = false;
+}
+
+bool Mutex::tryLock() {
+    if (__sync_lock_test_and_set(&locked, true))
+        return false;
+    owner = Scheduler::get()->getActiveThread();
+    return true;
+}
+
+void Mutex::lock() {
+    while (!tryLock()) {
+        // Sleeping resumes the scheduler, put it back the way the caller had it
+        Scheduler* scheduler = Scheduler::get();
+        Thread* thread = scheduler->getActiveThread();
+        bool paused = !scheduler->active;
+
+        thread->wait(new WaitForMutex(this));
+        thread->stopWaiting();
+
+        if (paused)
+            scheduler->pause();
+    }
+}
+
+void Mutex::unlock() {
+    owner = NULL;
+    __sync_lock_release(&locked);
+}
+
+bool Mutex::isLocked() {
+    return locked;
+}
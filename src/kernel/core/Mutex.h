@@ -0,0 +1,21 @@
+#ifndef CORE_MUTEX_H
+#define CORE_MUTEX_H
+
+#include <lang/lang.h>
+
+
+class Thread;
+
+class Mutex {
+public:
+    Mutex();
+    void lock();
+    bool tryLock();
+    void unlock();
+    bool isLocked();
+    Thread* owner;
+private:
+    volatile bool locked;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include <core/Process.h>
 #include <core/Thread.h>
+#include <fs/Epoll.h>
+#include <fs/IoRing.h>
 #include <kutil.h>
 #include <string.h>
 #include <signal.h>
@@ -151,6 +153,8 @@ void Process::closeFile(int fd) {
     files[fd] = NULL;
     if (f->refcount == 0) {
         klog('t', "Reaping FD %i", fd);
+        if (f->type == FILE_STREAM && ((StreamFile*)f)->watchCount)
+            Epoll::fileReaped((StreamFile*)f);
         f->close();
         delete f;
     }
@@ -192,6 +196,9 @@ void Process::notifyChildDied(Process* p, uint64_t status) {
 }
 
 Process::~Process() {
+    for (int i = 0; i < files.capacity; i++)
+        if (files[i] && files[i]->type == FILE_IORING)
+            ((IoRing*)files[i])->detach(this);
     for (int i = 0; i < files.capacity; i++)
         if (files[i])
             closeFile(i);
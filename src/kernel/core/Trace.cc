@@ -0,0 +1,86 @@
+#include <core/Trace.h>
+#include <core/CPU.h>
+#include <core/Process.h>
+#include <core/Scheduler.h>
+#include <core/Thread.h>
+#include <stdio.h>
+#include <string.h>
+
+
+trace_ring_t Trace::rings[KCFG_MAX_CPUS];
+bool Trace::enabled = true;
+
+
+uint64_t Trace::syscallEnter(uint64_t id, uint64_t* args) {
+    trace_ring_t* ring = &rings[CPU::getID()];
+    uint64_t seq = ++ring->head;
+    trace_record_t* r = &ring->records[seq % KCFG_TRACE_RING_SIZE];
+
+    Thread* t = Scheduler::get()->getActiveThread();
+
+    r->seq = seq;
+    r->id = id;
+    for (int i = 0; i < 6; i++)
+        r->args[i] = args[i];
+    r->result = 0;
+    r->pid = t->process->pid;
+    r->tid = t->id;
+    r->tscExit = 0;
+    r->tscEnter = CPU::RDTSC();
+    return seq;
+}
+
+void Trace::syscallExit(uint64_t seq, uint64_t result) {
+    uint64_t tsc = CPU::RDTSC();
+    trace_record_t* r = &rings[CPU::getID()].records[seq % KCFG_TRACE_RING_SIZE];
+
+    // The slot may have been recycled while this syscall was blocked
+    if (r->seq != seq)
+        return;
+
+    r->result = result;
+    r->tscExit = tsc;
+}
+
+uint64_t Trace::render(char* buffer, uint64_t size) {
+    uint64_t used = 0;
+
+    for (int cpu = 0; cpu < KCFG_MAX_CPUS; cpu++) {
+        trace_ring_t* ring = &rings[cpu];
+        uint64_t first = 1;
+        if (ring->head > KCFG_TRACE_RING_SIZE)
+            first = ring->head - KCFG_TRACE_RING_SIZE + 1;
+
+        for (uint64_t seq = first; seq <= ring->head; seq++) {
+            trace_record_t* r = &ring->records[seq % KCFG_TRACE_RING_SIZE];
+            if (r->seq != seq)
+                continue;
+
+            char line[256];
+            int len;
+            if (r->tscExit)
+                len = snprintf(line, 256, "[%i] %lu pid %i tid %i sys 0x%lx(0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx) = 0x%lx <%lu>\n",
+                    cpu, r->tscEnter, r->pid, r->tid, r->id,
+                    r->args[0], r->args[1], r->args[2], r->args[3], r->args[4], r->args[5],
+                    r->result, r->tscExit - r->tscEnter);
+            else
+                len = snprintf(line, 256, "[%i] %lu pid %i tid %i sys 0x%lx(0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx) = ? <unfinished>\n",
+                    cpu, r->tscEnter, r->pid, r->tid, r->id,
+                    r->args[0], r->args[1], r->args[2], r->args[3], r->args[4], r->args[5]);
+
+            if (len <= 0 || used + len > size)
+                return used;
+            memcpy(buffer + used, line, len);
+            used += len;
+        }
+    }
+
+    return used;
+}
+
+void Trace::clear() {
+    for (int cpu = 0; cpu < KCFG_MAX_CPUS; cpu++) {
+        memset(rings[cpu].records, 0, sizeof(rings[cpu].records));
+        rings[cpu].head = 0;
+    }
+}
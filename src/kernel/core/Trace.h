@@ -0,0 +1,34 @@
+#ifndef CORE_TRACE_H
+#define CORE_TRACE_H
+
+#include <lang/lang.h>
+#include <kconfig.h>
+
+
+struct trace_record_t {
+    uint64_t seq;
+    uint64_t tscEnter, tscExit;
+    uint64_t id;
+    uint64_t args[6];
+    uint64_t result;
+    uint32_t pid, tid;
+};
+
+struct trace_ring_t {
+    trace_record_t records[KCFG_TRACE_RING_SIZE];
+    uint64_t head;
+};
+
+
+class Trace {
+public:
+    static uint64_t syscallEnter(uint64_t id, uint64_t* args);
+    static void syscallExit(uint64_t seq, uint64_t result);
+    static uint64_t render(char* buffer, uint64_t size);
+    static void clear();
+    static bool enabled;
+private:
+    static trace_ring_t rings[KCFG_MAX_CPUS];
+};
+
+#endif
@@ -1,5 +1,10 @@
 #include <core/Wait.h>
+#include <core/Mutex.h>
+#include <block/BlockDevice.h>
+#include <fs/IoRing.h>
+#include <fs/Writeback.h>
 #include <hardware/pit/PIT.h>
+#include <poll.h>
 
 
 WaitForever::WaitForever() {
@@ -43,3 +48,100 @@ WaitForChild::WaitForChild(uint64_t p) {
 bool WaitForChild::isComplete() {
     return false;
 }
+
+
+
+WaitForEpoll::WaitForEpoll(Epoll* e, int64_t ms) {
+    type = WAIT_FOR_EPOLL;
+    epoll = e;
+    timeout = ms;
+    started = PIT::get()->getTime();
+}
+
+bool WaitForEpoll::isComplete() {
+    if (epoll->hasReady())
+        return true;
+    return timeout >= 0 && (int64_t)(PIT::get()->getTime() - started) >= timeout;
+}
+
+
+
+WaitForPoll::WaitForPoll(StreamFile** f, short* e, int c, int64_t ms) {
+    type = WAIT_FOR_POLL;
+    files = f;
+    events = e;
+    count = c;
+    timeout = ms;
+    started = PIT::get()->getTime();
+}
+
+bool WaitForPoll::isComplete() {
+    for (int i = 0; i < count; i++) {
+        if (!files[i])
+            continue;
+        if (files[i]->isEOF())
+            return true;
+        if ((events[i] & POLLIN) && files[i]->canRead())
+            return true;
+        if ((events[i] & POLLOUT) && files[i]->canWrite())
+            return true;
+    }
+    return timeout >= 0 && (int64_t)(PIT::get()->getTime() - started) >= timeout;
+}
+
+
+
+WaitForIoWork::WaitForIoWork() {
+    type = WAIT_FOR_IORING;
+}
+
+bool WaitForIoWork::isComplete() {
+    return IoRing::hasPendingWork();
+}
+
+
+
+WaitForIoCompletion::WaitForIoCompletion(IoRing* r, uint32_t c) {
+    type = WAIT_FOR_IORING;
+    ring = r;
+    count = c;
+}
+
+bool WaitForIoCompletion::isComplete() {
+    return ring->completions() >= count;
+}
+
+
+
+WaitForMutex::WaitForMutex(Mutex* m) {
+    type = WAIT_FOR_MUTEX;
+    mutex = m;
+}
+
+bool WaitForMutex::isComplete() {
+    return !mutex->isLocked();
+}
+
+
+
+WaitForWriteback::WaitForWriteback() {
+    type = WAIT_FOR_WRITEBACK;
+}
+
+bool WaitForWriteback::isComplete() {
+    return Writeback::get()->needsFlush();
+}
+
+
+
+WaitForBlock::WaitForBlock(block_request_t* r, BlockDevice* d) {
+    type = WAIT_FOR_BLOCK;
+    request = r;
+    device = d;
+}
+
+bool WaitForBlock::isComplete() {
+    if (!request->done)
+        device->poll();
+    return request->done;
+}
@@ -3,12 +3,19 @@
 
 #include <lang/lang.h>
 #include <fs/File.h>
+#include <fs/Epoll.h>
 
 
 #define WAIT_FOREVER 0
 #define WAIT_FOR_DELAY 1
 #define WAIT_FOR_FILE 2
 #define WAIT_FOR_CHILD 3
+#define WAIT_FOR_EPOLL 4
+#define WAIT_FOR_POLL 5
+#define WAIT_FOR_IORING 6
+#define WAIT_FOR_MUTEX 7
+#define WAIT_FOR_WRITEBACK 8
+#define WAIT_FOR_BLOCK 9
 
 
 class Wait {
@@ -50,4 +57,78 @@ public:
 private:
     uint64_t pid;
 };
+
+
+class WaitForEpoll : public Wait {
+public:
+    WaitForEpoll(Epoll* e, int64_t ms);
+    virtual bool isComplete();
+private:
+    Epoll* epoll;
+    uint64_t started;
+    int64_t timeout;
+};
+
+
+class IoRing;
+
+class WaitForIoWork : public Wait {
+public:
+    WaitForIoWork();
+    virtual bool isComplete();
+};
+
+
+class WaitForWriteback : public Wait {
+public:
+    WaitForWriteback();
+    virtual bool isComplete();
+};
+
+
+class WaitForIoCompletion : public Wait {
+public:
+    WaitForIoCompletion(IoRing* r, uint32_t count);
+    virtual bool isComplete();
+private:
+    IoRing* ring;
+    uint32_t count;
+};
+
+
+class Mutex;
+
+class WaitForMutex : public Wait {
+public:
+    WaitForMutex(Mutex* m);
+    virtual bool isComplete();
+private:
+    Mutex* mutex;
+};
+
+
+struct block_request_t;
+class BlockDevice;
+
+class WaitForBlock : public Wait {
+public:
+    WaitForBlock(block_request_t* r, BlockDevice* device);
+    virtual bool isComplete();
+private:
+    block_request_t* request;
+    BlockDevice* device;
+};
+
+
+class WaitForPoll : public Wait {
+public:
+    WaitForPoll(StreamFile** files, short* events, int count, int64_t ms);
+    virtual bool isComplete();
+private:
+    StreamFile** files;
+    short* events;
+    int count;
+    uint64_t started;
+    int64_t timeout;
+};
 #endif
\ No newline at end of file
@@ -7,10 +7,16 @@
 #include <core/Process.h>
 #include <core/Scheduler.h>
 #include <core/Wait.h>
+#include <hardware/ahci/AHCI.h>
+#include <hardware/ata/ATA.h>
 #include <hardware/keyboard/Keyboard.h>
+#include <hardware/nvme/NVMe.h>
+#include <hardware/pci/PCI.h>
+#include <hardware/virtio/VirtioBlock.h>
 #include <hardware/cmos/CMOS.h>
 #include <hardware/io.h>
 #include <hardware/pit/PIT.h>
+#include <hardware/serial/Serial.h>
 #include <hardware/vga/VGA.h>
 #include <interrupts/IDT.h>
 #include <interrupts/Interrupts.h>
@@ -23,10 +29,15 @@
 #include <fs/devfs/PTY.h>
 #include <fs/fat32/FAT32FS.h>
 #include <fs/procfs/ProcFS.h>
+#include <fs/tmpfs/Initramfs.h>
+#include <fs/tmpfs/TmpFS.h>
 #include <fs/vfs/VFS.h>
 #include <fs/File.h>
+#include <fs/IoRing.h>
+#include <fs/Writeback.h>
 #include <fs/Directory.h>
 
+#include <block/Partition.h>
 #include <elf/ELF.h>
 #include <multiboot.h>
 
@@ -64,6 +75,26 @@ void repainterThread(void*) {
 
 
 
+TmpFS* loadInitramfs(multiboot_info_t* mbi) {
+    if (!(mbi->flags & (1 << 3)) || !mbi->mods_count)
+        return NULL;
+
+    auto mod = (multiboot_mod_list_t*)(uint64_t)mbi->mods_addr;
+    if (mod->mod_end > KCFG_LOW_IDENTITY_PAGING_LENGTH) {
+        klog('w', "initramfs module at %x-%x is outside the identity map", mod->mod_start, mod->mod_end);
+        return NULL;
+    }
+
+    klog('i', "Loading initramfs (%i KB)", (mod->mod_end - mod->mod_start) / 1024);
+    TmpFS* fs = new TmpFS();
+    if (!Initramfs::load(fs, (uint8_t*)(uint64_t)mod->mod_start, mod->mod_end - mod->mod_start)) {
+        delete fs;
+        return NULL;
+    }
+    return fs;
+}
+
+
 extern "C" void kmain (multiboot_info_t* mbi) {
     __output("Starting up...", 0);
 
@@ -77,6 +108,7 @@ extern "C" void kmain (multiboot_info_t* mbi) {
     __output("Initializing heap...", 160);
     kalloc_switch_to_main_heap();
     klog_init();
+    Serial::get()->init();
 
     __output("Initializing VGA...", 240);
     VGA::enableHighResolution();
@@ -84,8 +116,7 @@ extern "C" void kmain (multiboot_info_t* mbi) {
     PhysicalTerminalManager::get()->init(5);
     klog_init_terminal();
     klog('s', "Kernel log started");
-
-    PhysicalTerminalManager::get()->render();
+    klog_flush();
 
     Debug::init();
     IDT::get()->init();
@@ -107,6 +138,9 @@ extern "C" void kmain (multiboot_info_t* mbi) {
     klog('i', "Starting scheduler");
     Scheduler::get()->init();
     klog_flush();
+    Scheduler::get()->spawnKernelThread(&klog_daemon, "klogd");
+    Scheduler::get()->spawnKernelThread(&IoRing::worker, "io_uring");
+    Scheduler::get()->spawnKernelThread(&Writeback::worker, "flushd");
     Scheduler::get()->spawnKernelThread(&repainterThread, "repainter");
     Scheduler::get()->resume();
 
@@ -115,10 +149,27 @@ extern "C" void kmain (multiboot_info_t* mbi) {
 
     klog('i', "");
     klog('i', "Setting up filesystem:");
+    ata_init();
+    PCI::get()->scan();
+    NVMeDisk::probe();
+    VirtioBlock::probe();
+    AHCIDisk::probe();
+    if (ata_sectors())
+        new ATADevice();
+    for (BlockDevice* d = BlockDevice::devices; d; d = d->next)
+        if (!d->parent)
+            Partition::scan(d);
     auto vfs = VFS::get();
-    vfs->mount("/", new FAT32FS());
+    TmpFS* rootfs = loadInitramfs(mbi);
+    if (rootfs) {
+        rootfs->mkdir("/mnt", 0755);
+        vfs->mount("/", rootfs);
+        vfs->mount("/mnt", new FAT32FS());
+    } else
+        vfs->mount("/", new FAT32FS());
     vfs->mount("/dev", new DevFS());
     vfs->mount("/proc", new ProcFS());
+    vfs->mount("/tmp", new TmpFS());
     klog('s', "Filesystem ready");
 
 
@@ -1,8 +1,13 @@
 #include <fs/Directory.h>
+#include <string.h>
 
 
-Directory::Directory(const char* path, FS* fs) : File(path, fs) {
+Directory::Directory(FS* fs, VNode* v) : File(fs, v) {
     type = FILE_DIRECTORY;
+    memset(&currentEntry, 0, sizeof(currentEntry));
+    position = 0;
+    pending = NULL;
+    hasPending = false;
 }
 
 int Directory::stat(struct stat* stat) {
@@ -10,3 +15,28 @@ int Directory::stat(struct stat* stat) {
     stat->st_mode |= S_IFDIR;
     return -1;
 }
+
+struct dirent* Directory::peek() {
+    if (!hasPending) {
+        pending = read();
+        hasPending = true;
+    }
+    return pending;
+}
+
+void Directory::advance() {
+    if (!peek())
+        return;
+    position++;
+    hasPending = false;
+}
+
+void Directory::seek(uint64_t cookie) {
+    if (cookie < position) {
+        rewind();
+        position = 0;
+        hasPending = false;
+    }
+    while (position < cookie && peek())
+        advance();
+}
@@ -11,12 +11,24 @@ class FS;
 
 class Directory : public File {
 public:
-    Directory(const char*, FS*);
+    Directory(FS*, VNode* vnode = 0);
     virtual struct dirent* read() = 0;
+    virtual void rewind() = 0;
     virtual void close() = 0;
     virtual int stat(struct stat* stat);
+
+    // Resumable iteration. position is the cookie of the next entry:
+    // peek() returns that entry without consuming it, advance() moves
+    // past it and seek() returns to a cookie handed out earlier
+    struct dirent* peek();
+    void advance();
+    void seek(uint64_t cookie);
+    uint64_t position;
 protected:
     struct dirent currentEntry;
+private:
+    struct dirent* pending;
+    bool hasPending;
 };
 
 
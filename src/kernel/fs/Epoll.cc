@@ -0,0 +1,242 @@
+#include <fs/Epoll.h>
+#include <kutil.h>
+#include <errno.h>
+
+
+Epoll* Epoll::instances = NULL;
+
+
+void EpollItem::fileReady() {
+    if (!queued && !disabled)
+        epoll->queue(this);
+}
+
+uint32_t EpollItem::getEvents() {
+    uint32_t revents = 0;
+    bool eof = file->isEOF();
+
+    if ((event.events & EPOLLIN) && (eof || file->canRead()))
+        revents |= EPOLLIN;
+    if ((event.events & EPOLLOUT) && file->canWrite())
+        revents |= EPOLLOUT;
+    if (eof)
+        revents |= EPOLLHUP;
+    return revents;
+}
+
+
+
+Epoll::Epoll() : File(NULL) {
+    type = FILE_EPOLL;
+    items = NULL;
+    readyHead = readyTail = NULL;
+    unnotifiedCount = 0;
+
+    nextInstance = instances;
+    instances = this;
+}
+
+void Epoll::close() {
+    while (items)
+        drop(items);
+
+    Epoll** p = &instances;
+    while (*p) {
+        if (*p == this) {
+            *p = nextInstance;
+            break;
+        }
+        p = &(*p)->nextInstance;
+    }
+}
+
+int Epoll::stat(struct stat* stat) {
+    File::stat(stat);
+    stat->st_mode = S_IRUSR | S_IWUSR;
+    return 0;
+}
+
+int Epoll::add(int fd, StreamFile* f, struct epoll_event* e) {
+    if (find(fd)) {
+        seterr(EEXIST);
+        return -1;
+    }
+
+    EpollItem* item = new EpollItem();
+    item->epoll = this;
+    item->file = f;
+    item->fd = fd;
+    item->event = *e;
+    item->queued = false;
+    item->disabled = false;
+    item->nextReady = NULL;
+    item->next = items;
+    items = item;
+
+    f->watchCount++;
+    if (f->notifiesReadiness())
+        f->addWatcher(item);
+    else
+        unnotifiedCount++;
+
+    // Pick up readiness that predates the registration
+    if (item->getEvents())
+        queue(item);
+    return 0;
+}
+
+int Epoll::modify(int fd, struct epoll_event* e) {
+    EpollItem* item = find(fd);
+    if (!item) {
+        seterr(ENOENT);
+        return -1;
+    }
+
+    item->event = *e;
+    item->disabled = false;
+    if (!item->queued && item->getEvents())
+        queue(item);
+    return 0;
+}
+
+int Epoll::remove(int fd) {
+    EpollItem* item = find(fd);
+    if (!item) {
+        seterr(ENOENT);
+        return -1;
+    }
+    drop(item);
+    return 0;
+}
+
+int Epoll::collect(struct epoll_event* events, int max) {
+    pollUnnotified();
+
+    // Level-triggered items go back on the queue after being reported, so
+    // that the next call re-checks them without rescanning the interest list
+    EpollItem* requeueHead = NULL;
+    EpollItem* requeueTail = NULL;
+    int n = 0;
+
+    while (n < max && readyHead) {
+        EpollItem* item = readyHead;
+        readyHead = item->nextReady;
+        if (!readyHead)
+            readyTail = NULL;
+        item->nextReady = NULL;
+        item->queued = false;
+
+        if (item->disabled)
+            continue;
+        uint32_t revents = item->getEvents();
+        if (!revents)
+            continue;
+
+        events[n].events = revents;
+        events[n].data = item->event.data;
+        n++;
+
+        if (item->event.events & EPOLLONESHOT)
+            item->disabled = true;
+        else if (!(item->event.events & EPOLLET)) {
+            item->queued = true;
+            if (requeueTail)
+                requeueTail->nextReady = item;
+            else
+                requeueHead = item;
+            requeueTail = item;
+        }
+    }
+
+    if (requeueHead) {
+        if (readyTail)
+            readyTail->nextReady = requeueHead;
+        else
+            readyHead = requeueHead;
+        readyTail = requeueTail;
+    }
+
+    return n;
+}
+
+bool Epoll::hasReady() {
+    pollUnnotified();
+
+    while (readyHead) {
+        if (!readyHead->disabled && readyHead->getEvents())
+            return true;
+        EpollItem* item = readyHead;
+        readyHead = item->nextReady;
+        if (!readyHead)
+            readyTail = NULL;
+        item->nextReady = NULL;
+        item->queued = false;
+    }
+    return false;
+}
+
+void Epoll::queue(EpollItem* item) {
+    item->queued = true;
+    item->nextReady = NULL;
+    if (readyTail)
+        readyTail->nextReady = item;
+    else
+        readyHead = item;
+    readyTail = item;
+}
+
+void Epoll::fileReaped(StreamFile* f) {
+    for (Epoll* ep = instances; ep; ep = ep->nextInstance) {
+        EpollItem* item = ep->items;
+        while (item) {
+            EpollItem* next = item->next;
+            if (item->file == f)
+                ep->drop(item);
+            item = next;
+        }
+    }
+}
+
+EpollItem* Epoll::find(int fd) {
+    for (EpollItem* item = items; item; item = item->next)
+        if (item->fd == fd)
+            return item;
+    return NULL;
+}
+
+void Epoll::drop(EpollItem* item) {
+    EpollItem** p = &items;
+    while (*p != item)
+        p = &(*p)->next;
+    *p = item->next;
+
+    if (item->queued) {
+        EpollItem* prev = NULL;
+        for (EpollItem* i = readyHead; i; prev = i, i = i->nextReady)
+            if (i == item) {
+                if (prev)
+                    prev->nextReady = item->nextReady;
+                else
+                    readyHead = item->nextReady;
+                if (readyTail == item)
+                    readyTail = prev;
+                break;
+            }
+    }
+
+    item->file->watchCount--;
+    if (item->file->notifiesReadiness())
+        item->file->removeWatcher(item);
+    else
+        unnotifiedCount--;
+    delete item;
+}
+
+void Epoll::pollUnnotified() {
+    // Files without readiness callbacks are checked by level on every call
+    if (!unnotifiedCount)
+        return;
+    for (EpollItem* item = items; item; item = item->next)
+        if (!item->queued && !item->disabled && !item->file->notifiesReadiness() && item->getEvents())
+            queue(item);
+}
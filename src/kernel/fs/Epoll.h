@@ -0,0 +1,53 @@
+#ifndef FS_EPOLL_H
+#define FS_EPOLL_H
+
+#include <fs/File.h>
+#include <sys/epoll.h>
+
+
+class Epoll;
+
+class EpollItem : public FileWatcher {
+public:
+    virtual void fileReady();
+    uint32_t getEvents();
+
+    Epoll* epoll;
+    StreamFile* file;
+    int fd;
+    struct epoll_event event;
+    bool queued, disabled;
+    EpollItem* next;
+    EpollItem* nextReady;
+};
+
+
+class Epoll : public File {
+public:
+    Epoll();
+    virtual void close();
+    virtual int stat(struct stat* stat);
+
+    int add(int fd, StreamFile* f, struct epoll_event* e);
+    int modify(int fd, struct epoll_event* e);
+    int remove(int fd);
+    int collect(struct epoll_event* events, int max);
+    bool hasReady();
+    void queue(EpollItem* item);
+
+    static void fileReaped(StreamFile* f);
+private:
+    EpollItem* find(int fd);
+    void drop(EpollItem* item);
+    void pollUnnotified();
+
+    EpollItem* items;
+    EpollItem* readyHead;
+    EpollItem* readyTail;
+    int unnotifiedCount;
+    Epoll* nextInstance;
+
+    static Epoll* instances;
+};
+
+#endif
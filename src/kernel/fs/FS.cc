@@ -1,8 +1,13 @@
 #include <fs/FS.h>
 #include <kutil.h>
 #include <errno.h>
+#include <fcntl.h>
 
 
+FS::FS() {
+    vnodes = NULL;
+}
+
 char* FS::getName() {
     return "Unknown FS";
 }
@@ -14,3 +19,74 @@ void FS::rename(char* opath, char* npath) {
 void FS::unlink(char* path) {
     seterr(EROFS);
 }
+
+void FS::mkdir(char* path, int mode) {
+    seterr(EROFS);
+}
+
+void FS::rmdir(char* path) {
+    seterr(EROFS);
+}
+
+int FS::stat(char* path, struct stat* stat) {
+    // Fallback for filesystems without a native stat
+    auto f = open(path, O_RDONLY);
+    if (f) {
+        f->stat(stat);
+        f->close();
+        delete f;
+        return 0;
+    }
+    geterr();
+
+    auto d = opendir(path);
+    if (!d) {
+        if (!haserr())
+            seterr(ENOENT);
+        return -1;
+    }
+    d->stat(stat);
+    d->close();
+    delete d;
+    return 0;
+}
+
+int FS::lstat(char* path, struct stat* stat) {
+    return this->stat(path, stat);
+}
+
+bool FS::cacheDentries() {
+    return false;
+}
+
+bool FS::caseInsensitive() {
+    return false;
+}
+
+VNode* FS::findVNode(uint64_t id) {
+    VNode* v = vnodes;
+    while (v && v->id != id)
+        v = v->next;
+    return v;
+}
+
+void FS::addVNode(VNode* vnode) {
+    vnode->next = vnodes;
+    vnodes = vnode;
+}
+
+void FS::releaseVNode(VNode* vnode) {
+    VNode** p = &vnodes;
+    while (*p && *p != vnode)
+        p = &(*p)->next;
+    if (*p)
+        *p = vnode->next;
+    delete vnode;
+}
+
+bool FS::chargePage() {
+    return true;
+}
+
+void FS::unchargePage() {
+}
@@ -4,16 +4,43 @@
 #include <lang/lang.h>
 #include <fs/File.h>
 #include <fs/Directory.h>
+#include <fs/VNode.h>
 #include <sys/stat.h>
 
 
 class FS {
 public:
+    FS();
     virtual char* getName();
     virtual StreamFile* open(char* path, int flags) = 0;
     virtual Directory* opendir(char* path) = 0;
     virtual void rename(char* opath, char* npath);
     virtual void unlink(char* path);
+    virtual void mkdir(char* path, int mode);
+    virtual void rmdir(char* path);
+
+    // Metadata by path, without opening anything. lstat does not
+    // follow a final symbolic link
+    virtual int stat(char* path, struct stat* stat);
+    virtual int lstat(char* path, struct stat* stat);
+
+    // Whether path lookups on this FS may be served from the dentry cache
+    virtual bool cacheDentries();
+
+    // Whether names that differ only in ASCII case refer to the same entry
+    virtual bool caseInsensitive();
+
+    // Called when the last reference to a vnode is dropped
+    virtual void releaseVNode(VNode* vnode);
+
+    // Called as page caches grow and shrink. Refusing the charge makes
+    // addPage() fail, for filesystems that live in the cache
+    virtual bool chargePage();
+    virtual void unchargePage();
+protected:
+    VNode* findVNode(uint64_t id);
+    void addVNode(VNode* vnode);
+    VNode* vnodes;
 };
 
 #endif
\ No newline at end of file
@@ -1,16 +1,24 @@
 #include <fs/File.h>
+#include <fs/VNode.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <kutil.h> 
 
 
-File::File(const char* path, FS* fs) {
-    strcpy(this->path, path ? path : "");
+File::File(FS* fs, VNode* v) {
     filesystem = fs;
+    vnode = v;
+    if (vnode)
+        vnode->acquire();
     refcount = 0;
     flags = 0;
 }
 
 void File::close() {
+    if (vnode)
+        vnode->release();
+    vnode = NULL;
 }
 
 bool File::isEOF() {
@@ -20,7 +28,16 @@ bool File::isEOF() {
 void File::fdClosed() {
 }
 
+int File::sync() {
+    return 0;
+}
+
 int File::stat(struct stat* stat) {
+    stat_init(stat);
+    return -1;
+}
+
+void stat_init(struct stat* stat) {
     stat->st_dev = 0;
     stat->st_ino = 1;
     stat->st_mode = S_IRWXU | S_IRWXG | S_IRWXO;
@@ -30,14 +47,15 @@ int File::stat(struct stat* stat) {
     stat->st_size = 0;
     stat->st_blksize = 512; // !
     stat->st_blocks = 0;
-    return -1;
 }
 
 
 
 
-StreamFile::StreamFile(const char* path, FS* fs) : File(path, fs) {
+StreamFile::StreamFile(FS* fs, VNode* v) : File(fs, v) {
     type = FILE_STREAM;
+    watchCount = 0;
+    watchers = NULL;
 }
 
 int StreamFile::write(const void* buffer, uint64_t count) {
@@ -56,9 +74,105 @@ bool StreamFile::canRead() {
     return false;
 }
 
+bool StreamFile::canWrite() {
+    return true;
+}
+
+int64_t StreamFile::readv(const struct iovec* iov, int count) {
+    int64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t c = read(iov[i].iov_base, iov[i].iov_len);
+        if (c == (uint64_t)-1)
+            return total ? total : -1;
+        total += c;
+        if (c < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
+int64_t StreamFile::writev(const struct iovec* iov, int count) {
+    int64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        int c = write(iov[i].iov_base, iov[i].iov_len);
+        if (c <= 0)
+            break;
+        total += c;
+        if ((uint64_t)c < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
+int64_t StreamFile::preadv(const struct iovec* iov, int count, uint64_t offset) {
+    uint64_t position = seek(0, SEEK_CUR);
+    if (position == (uint64_t)-1) {
+        seterr(ESPIPE);
+        return -1;
+    }
+    seek(offset, SEEK_SET);
+    int64_t c = readv(iov, count);
+    seek(position, SEEK_SET);
+    return c;
+}
+
+int64_t StreamFile::pwritev(const struct iovec* iov, int count, uint64_t offset) {
+    uint64_t position = seek(0, SEEK_CUR);
+    if (position == (uint64_t)-1) {
+        seterr(ESPIPE);
+        return -1;
+    }
+    seek(offset, SEEK_SET);
+    int64_t c = writev(iov, count);
+    seek(position, SEEK_SET);
+    return c;
+}
+
+Pipe* StreamFile::getPipe(bool writing) {
+    return NULL;
+}
+
+bool StreamFile::notifiesReadiness() {
+    return false;
+}
+
+void StreamFile::addWatcher(FileWatcher* w) {
+    watchers_add(&watchers, w);
+}
+
+void StreamFile::removeWatcher(FileWatcher* w) {
+    watchers_remove(&watchers, w);
+}
+
+void StreamFile::notifyWatchers() {
+    watchers_notify(watchers);
+}
+
+
+void watchers_add(FileWatcher** list, FileWatcher* w) {
+    w->nextWatcher = *list;
+    *list = w;
+}
+
+void watchers_remove(FileWatcher** list, FileWatcher* w) {
+    while (*list) {
+        if (*list == w) {
+            *list = w->nextWatcher;
+            w->nextWatcher = NULL;
+            return;
+        }
+        list = &(*list)->nextWatcher;
+    }
+}
+
+void watchers_notify(FileWatcher* list) {
+    for (FileWatcher* w = list; w; w = w->nextWatcher)
+        w->fileReady();
+}
+
 
 
-StaticFile::StaticFile(void* c, uint64_t s) : StreamFile(NULL, NULL) {
+StaticFile::StaticFile(void* c, uint64_t s) : StreamFile(NULL) {
     content = c;
     size = s;
     offset = 0;
@@ -3,38 +3,81 @@
 
 #include <lang/lang.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 
 class FS;
+class Pipe;
+class VNode;
 
 #define FILE_STREAM 0
 #define FILE_DIRECTORY 1
+#define FILE_EPOLL 2
+#define FILE_IORING 3
 
 
 class File {
 public:
-    File(const char* path, FS*);
+    File(FS*, VNode* vnode = 0);
     virtual void close();
     virtual int stat(struct stat* stat);
     virtual bool isEOF();
     virtual void fdClosed();
+    // Gets everything written through this file onto the disk
+    virtual int sync();
 
     int type;
     int refcount;
     int flags;
+    VNode* vnode;
 protected:
-    char path[1024];
     FS* filesystem;
 };
 
 
+class FileWatcher {
+public:
+    virtual void fileReady() = 0;
+    FileWatcher* nextWatcher;
+};
+
+// Fills in the fields every stat result shares
+void stat_init(struct stat* stat);
+
+void watchers_add(FileWatcher** list, FileWatcher* w);
+void watchers_remove(FileWatcher** list, FileWatcher* w);
+void watchers_notify(FileWatcher* list);
+
+
 class StreamFile : public File {
 public:
-    StreamFile(const char*, FS*);
+    StreamFile(FS*, VNode* vnode = 0);
     virtual int write(const void* buffer, uint64_t count);
     virtual uint64_t read(void* buffer, uint64_t count);
     virtual uint64_t seek(uint64_t offset, uint64_t whence);
     virtual bool canRead();
+    virtual bool canWrite();
+
+    // Scatter/gather and positional I/O. The defaults are built on
+    // read()/write()/seek(); files that can do better override them
+    virtual int64_t readv(const struct iovec* iov, int count);
+    virtual int64_t writev(const struct iovec* iov, int count);
+    virtual int64_t preadv(const struct iovec* iov, int count, uint64_t offset);
+    virtual int64_t pwritev(const struct iovec* iov, int count, uint64_t offset);
+
+    // The pipe backing this file in the given direction, if any
+    virtual Pipe* getPipe(bool writing);
+
+    // Readiness notification: files that return true from
+    // notifiesReadiness() call fileReady() on their watchers whenever
+    // canRead()/canWrite()/isEOF() may have changed
+    virtual bool notifiesReadiness();
+    virtual void addWatcher(FileWatcher* w);
+    virtual void removeWatcher(FileWatcher* w);
+    int watchCount;
+protected:
+    void notifyWatchers();
+    FileWatcher* watchers;
 };
 
 
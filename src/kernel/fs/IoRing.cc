@@ -0,0 +1,318 @@
+#include <fs/IoRing.h>
+#include <fs/vfs/VFS.h>
+#include <core/CPU.h>
+#include <core/Process.h>
+#include <core/Scheduler.h>
+#include <core/Thread.h>
+#include <alloc/malloc.h>
+#include <memory/AddressSpace.h>
+#include <kutil.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+
+
+IoRing* IoRing::instances = NULL;
+
+
+IoRing::IoRing(Process* p) : File(NULL) {
+    type = FILE_IORING;
+    process = p;
+    rings = NULL;
+    sqes = NULL;
+    pending = NULL;
+    pendingHead = pendingTail = 0;
+    ringsMapping = sqesMapping = 0;
+
+    nextInstance = instances;
+    instances = this;
+}
+
+bool IoRing::setup(uint32_t entries, struct io_uring_params* params) {
+    if (!entries || entries > IORING_MAX_ENTRIES || params->flags) {
+        seterr(EINVAL);
+        return false;
+    }
+
+    uint32_t sqEntries = 1;
+    while (sqEntries < entries)
+        sqEntries *= 2;
+    uint32_t cqEntries = sqEntries * 2;
+
+    uint64_t arrayOffset = sizeof(io_rings_t);
+    uint64_t cqesOffset = (arrayOffset + sqEntries * sizeof(uint32_t) + 63) / 64 * 64;
+    ringsSize = PAGECEIL(cqesOffset + cqEntries * sizeof(io_uring_cqe));
+    sqesSize = PAGECEIL(sqEntries * sizeof(io_uring_sqe));
+
+    // Both regions live in the kernel heap, which every address space
+    // shares, so the worker can reach them without switching spaces
+    rings = (io_rings_t*)kvalloc(ringsSize);
+    sqes = (io_uring_sqe*)kvalloc(sqesSize);
+    pending = new io_uring_sqe[cqEntries];
+    memset(rings, 0, ringsSize);
+    memset(sqes, 0, sqesSize);
+
+    rings->sqMask = sqEntries - 1;
+    rings->sqEntries = sqEntries;
+    rings->cqMask = cqEntries - 1;
+    rings->cqEntries = cqEntries;
+    sqArray = (uint32_t*)((uint64_t)rings + arrayOffset);
+    cqes = (io_uring_cqe*)((uint64_t)rings + cqesOffset);
+
+    params->sq_entries = sqEntries;
+    params->cq_entries = cqEntries;
+    params->features = IORING_FEAT_SINGLE_MMAP;
+    memset(&params->sq_off, 0, sizeof(params->sq_off));
+    memset(&params->cq_off, 0, sizeof(params->cq_off));
+    params->sq_off.head = offsetof(io_rings_t, sqHead);
+    params->sq_off.tail = offsetof(io_rings_t, sqTail);
+    params->sq_off.ring_mask = offsetof(io_rings_t, sqMask);
+    params->sq_off.ring_entries = offsetof(io_rings_t, sqEntries);
+    params->sq_off.flags = offsetof(io_rings_t, sqFlags);
+    params->sq_off.dropped = offsetof(io_rings_t, sqDropped);
+    params->sq_off.array = arrayOffset;
+    params->cq_off.head = offsetof(io_rings_t, cqHead);
+    params->cq_off.tail = offsetof(io_rings_t, cqTail);
+    params->cq_off.ring_mask = offsetof(io_rings_t, cqMask);
+    params->cq_off.ring_entries = offsetof(io_rings_t, cqEntries);
+    params->cq_off.overflow = offsetof(io_rings_t, cqOverflow);
+    params->cq_off.flags = offsetof(io_rings_t, cqFlags);
+    params->cq_off.cqes = cqesOffset;
+    return true;
+}
+
+uint64_t IoRing::map(uint64_t offset, uint64_t length) {
+    uint64_t base, size;
+    uint64_t* mapping;
+
+    if (offset == IORING_OFF_SQ_RING || offset == IORING_OFF_CQ_RING) {
+        base = (uint64_t)rings;
+        size = ringsSize;
+        mapping = &ringsMapping;
+    } else if (offset == IORING_OFF_SQES) {
+        base = (uint64_t)sqes;
+        size = sqesSize;
+        mapping = &sqesMapping;
+    } else {
+        seterr(EINVAL);
+        return 0;
+    }
+
+    if (length > size) {
+        seterr(EINVAL);
+        return 0;
+    }
+
+    // With a single mmap the CQ ring shares the SQ ring's mapping
+    if (*mapping)
+        return *mapping;
+
+    AddressSpace* space = process->addressSpace;
+    uint64_t addr = PAGECEIL(process->brk);
+    process->brk = addr + size;
+
+    // Not PAGEATTR_SHARED: a forked child must not keep these pages,
+    // since the heap memory behind them goes away with the ring
+    for (uint64_t v = 0; v < size; v += KCFG_PAGE_SIZE)
+        space->mapPage(
+            space->getPage(addr + v, true),
+            space->getPhysicalAddress(base + v),
+            PAGEATTR_USER | PAGEATTR_BORROWED
+        );
+    space->namePage(space->getPage(addr, false), "io_uring");
+
+    *mapping = addr;
+    return addr;
+}
+
+uint32_t IoRing::submit(uint32_t count) {
+    uint32_t submitted = 0;
+    uint32_t tail = __atomic_load_n(&rings->sqTail, __ATOMIC_ACQUIRE);
+    uint32_t head = rings->sqHead;
+
+    while (submitted < count && head != tail && pendingTail - pendingHead < rings->cqEntries) {
+        uint32_t index = sqArray[head & rings->sqMask];
+        head++;
+        if (index >= rings->sqEntries) {
+            rings->sqDropped++;
+            continue;
+        }
+        pending[pendingTail++ % rings->cqEntries] = sqes[index];
+        submitted++;
+    }
+
+    __atomic_store_n(&rings->sqHead, head, __ATOMIC_RELEASE);
+    return submitted;
+}
+
+uint32_t IoRing::completions() {
+    return __atomic_load_n(&rings->cqTail, __ATOMIC_ACQUIRE) - __atomic_load_n(&rings->cqHead, __ATOMIC_ACQUIRE);
+}
+
+void IoRing::unmap() {
+    if (!process)
+        return;
+
+    AddressSpace* space = process->addressSpace;
+    if (ringsMapping)
+        space->releaseSpace(ringsMapping, ringsSize);
+    if (sqesMapping)
+        space->releaseSpace(sqesMapping, sqesSize);
+    if (AddressSpace::current == space)
+        space->activate();
+    ringsMapping = sqesMapping = 0;
+}
+
+void IoRing::detach(Process* p) {
+    // Work submitted by an exiting owner has nowhere to run
+    if (process == p) {
+        unmap();
+        process = NULL;
+        pendingHead = pendingTail;
+    }
+}
+
+void IoRing::close() {
+    IoRing** p = &instances;
+    while (*p) {
+        if (*p == this) {
+            *p = nextInstance;
+            break;
+        }
+        p = &(*p)->nextInstance;
+    }
+
+    if (!rings)
+        return;
+
+    // The owner's address space is the only one that maps the rings
+    unmap();
+    kfree(rings);
+    kfree(sqes);
+    delete[] pending;
+}
+
+void IoRing::complete(uint64_t userData, int32_t result) {
+    uint32_t tail = rings->cqTail;
+    if (tail - __atomic_load_n(&rings->cqHead, __ATOMIC_ACQUIRE) >= rings->cqEntries) {
+        rings->cqOverflow++;
+        return;
+    }
+
+    io_uring_cqe* cqe = &cqes[tail & rings->cqMask];
+    cqe->user_data = userData;
+    cqe->res = result;
+    cqe->flags = 0;
+    __atomic_store_n(&rings->cqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+int32_t IoRing::execute(struct io_uring_sqe* sqe) {
+    if (sqe->opcode == IORING_OP_NOP)
+        return 0;
+
+    if (sqe->opcode == IORING_OP_OPENAT) {
+        if (sqe->fd != AT_FDCWD && ((char*)sqe->addr)[0] != '/')
+            return -EINVAL;
+
+        char path[1024];
+        process->realpath((char*)sqe->addr, path);
+        File* f;
+        if (sqe->open_flags & O_DIRECTORY)
+            f = VFS::get()->opendir(path);
+        else
+            f = VFS::get()->open(path, sqe->open_flags);
+        if (haserr())
+            return -geterr();
+        return process->attachFile(f);
+    }
+
+    if (sqe->fd < 0 || sqe->fd >= process->files.capacity || !process->files[sqe->fd])
+        return -EBADF;
+    File* file = process->files[sqe->fd];
+
+    if (sqe->opcode == IORING_OP_CLOSE) {
+        if (file == this)
+            return -EINVAL;
+        process->closeFile(sqe->fd);
+        return 0;
+    }
+
+    if (sqe->opcode == IORING_OP_FSYNC)
+        return (file->sync() < 0) ? -geterr() : 0;
+
+    if (file->type != FILE_STREAM)
+        return -EINVAL;
+    StreamFile* f = (StreamFile*)file;
+
+    struct iovec single = { (void*)sqe->addr, sqe->len };
+    const struct iovec* iov = &single;
+    int count = 1;
+    bool writing;
+
+    switch (sqe->opcode) {
+        case IORING_OP_READ:
+            writing = false;
+            break;
+        case IORING_OP_WRITE:
+            writing = true;
+            break;
+        case IORING_OP_READV:
+        case IORING_OP_WRITEV:
+            iov = (const struct iovec*)sqe->addr;
+            count = sqe->len;
+            writing = sqe->opcode == IORING_OP_WRITEV;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    // The worker never blocks: the caller can poll and resubmit
+    if (!writing && f->notifiesReadiness() && !f->canRead() && !f->isEOF())
+        return -EAGAIN;
+
+    int64_t result;
+    if (sqe->off == (uint64_t)-1)
+        result = writing ? f->writev(iov, count) : f->readv(iov, count);
+    else
+        result = writing ? f->pwritev(iov, count, sqe->off) : f->preadv(iov, count, sqe->off);
+
+    if (result < 0)
+        return -geterr();
+    return result;
+}
+
+void IoRing::run() {
+    if (!process || pendingHead == pendingTail)
+        return;
+
+    process->addressSpace->activate();
+    while (pendingHead != pendingTail) {
+        io_uring_sqe* sqe = &pending[pendingHead++ % rings->cqEntries];
+        geterr();
+        complete(sqe->user_data, execute(sqe));
+    }
+    AddressSpace::kernelSpace->activate();
+}
+
+bool IoRing::hasPendingWork() {
+    for (IoRing* ring = instances; ring; ring = ring->nextInstance)
+        if (ring->process && ring->pendingHead != ring->pendingTail)
+            return true;
+    return false;
+}
+
+void IoRing::worker(void*) {
+    for (;;) {
+        Scheduler::get()->getActiveThread()->wait(new WaitForIoWork());
+        // The file layer expects the scheduler paused, as in a syscall,
+        // so every op runs to completion before anything else is
+        // scheduled. Submission returns early, but no I/O overlaps
+        // with the submitter or with other ops yet
+        Scheduler::get()->pause();
+        for (IoRing* ring = instances; ring; ring = ring->nextInstance)
+            ring->run();
+        Scheduler::get()->resume();
+        CPU::STI();
+    }
+}
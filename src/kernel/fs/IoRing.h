@@ -0,0 +1,117 @@
+#ifndef FS_IORING_H
+#define FS_IORING_H
+
+#include <fs/File.h>
+#include <kconfig.h>
+
+
+// Userspace ABI, laid out as in Linux <linux/io_uring.h>
+
+struct io_uring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t ioprio;
+    int32_t  fd;
+    uint64_t off;
+    uint64_t addr;
+    uint32_t len;
+    union {
+        uint32_t rw_flags;
+        uint32_t fsync_flags;
+        uint32_t open_flags;
+    };
+    uint64_t user_data;
+    uint64_t __pad2[3];
+};
+
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t  res;
+    uint32_t flags;
+};
+
+struct io_sqring_offsets {
+    uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array, resv1;
+    uint64_t resv2;
+};
+
+struct io_cqring_offsets {
+    uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags, resv1;
+    uint64_t resv2;
+};
+
+struct io_uring_params {
+    uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle, features, wq_fd;
+    uint32_t resv[3];
+    struct io_sqring_offsets sq_off;
+    struct io_cqring_offsets cq_off;
+};
+
+#define IORING_OP_NOP       0
+#define IORING_OP_READV     1
+#define IORING_OP_WRITEV    2
+#define IORING_OP_FSYNC     3
+#define IORING_OP_OPENAT    18
+#define IORING_OP_CLOSE     19
+#define IORING_OP_READ      22
+#define IORING_OP_WRITE     23
+
+#define IORING_OFF_SQ_RING  0x00000000ULL
+#define IORING_OFF_CQ_RING  0x08000000ULL
+#define IORING_OFF_SQES     0x10000000ULL
+
+#define IORING_ENTER_GETEVENTS  1
+#define IORING_FEAT_SINGLE_MMAP 1
+
+#define IORING_MAX_ENTRIES 4096
+
+
+// Shared ring header; the SQ index array and the CQEs follow it
+struct io_rings_t {
+    uint32_t sqHead, sqTail, sqMask, sqEntries, sqFlags, sqDropped;
+    uint32_t pad0[10];
+    uint32_t cqHead, cqTail, cqMask, cqEntries, cqOverflow, cqFlags;
+    uint32_t pad1[10];
+};
+
+
+class Process;
+
+class IoRing : public File {
+public:
+    IoRing(Process* p);
+    virtual void close();
+
+    bool setup(uint32_t entries, struct io_uring_params* params);
+    uint64_t map(uint64_t offset, uint64_t length);
+    uint32_t submit(uint32_t count);
+    uint32_t completions();
+    // Drops the owner's mappings of the rings
+    void unmap();
+    void detach(Process* p);
+
+    Process* process;
+
+    static bool hasPendingWork();
+    static void worker(void*);
+private:
+    void run();
+    int32_t execute(struct io_uring_sqe* sqe);
+    void complete(uint64_t userData, int32_t result);
+
+    io_rings_t* rings;
+    uint32_t* sqArray;
+    io_uring_cqe* cqes;
+    io_uring_sqe* sqes;
+    uint64_t ringsSize, sqesSize;
+    uint64_t ringsMapping, sqesMapping;
+
+    // Submissions copied out of the shared ring, awaiting the worker
+    io_uring_sqe* pending;
+    uint32_t pendingHead, pendingTail;
+
+    IoRing* nextInstance;
+    static IoRing* instances;
+};
+
+#endif
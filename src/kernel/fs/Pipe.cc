@@ -1,40 +1,245 @@
 #include <fs/Pipe.h>
+#include <alloc/malloc.h>
 #include <kutil.h>
 #include <string.h>
 
 
-Pipe::Pipe() : StreamFile(0, 0) {
+static pipe_page_t* pipe_page_alloc() {
+    pipe_page_t* page = new pipe_page_t();
+    page->data = (uint8_t*)kvalloc(KCFG_PAGE_SIZE);
+    page->refcount = 1;
+    return page;
+}
+
+static void pipe_page_release(pipe_page_t* page) {
+    if (--page->refcount == 0) {
+        kfree(page->data);
+        delete page;
+    }
+}
+
+
+Pipe::Pipe() : StreamFile(0) {
     bufferLength = 0;
+    head = used = 0;
     closed = false;
 }
 
+void Pipe::close() {
+    consume(bufferLength);
+}
+
+pipe_slot_t* Pipe::pushSlot() {
+    if (used == PIPE_SLOTS)
+        return NULL;
+    pipe_slot_t* s = &slots[(head + used++) % PIPE_SLOTS];
+    s->page = NULL;
+    s->offset = s->length = 0;
+    return s;
+}
+
+void Pipe::consume(uint64_t count) {
+    while (count && used) {
+        pipe_slot_t* s = &slots[head];
+        uint64_t c = (count < s->length) ? count : s->length;
+        s->offset += c;
+        s->length -= c;
+        bufferLength -= c;
+        count -= c;
+        if (!s->length) {
+            pipe_page_release(s->page);
+            head = (head + 1) % PIPE_SLOTS;
+            used--;
+        }
+    }
+}
+
 int Pipe::write(const void* buffer, uint64_t count) {
-    if (bufferLength + count > PIPE_BUFFER_SIZE) {
-        klog('e', "Pipe overflow");
+    uint64_t done = 0;
+
+    while (done < count) {
+        pipe_slot_t* s = used ? &slots[(head + used - 1) % PIPE_SLOTS] : NULL;
+        // Pages shared with another pipe by tee() are immutable
+        if (!s || s->page->refcount > 1 || s->offset + s->length == KCFG_PAGE_SIZE) {
+            s = pushSlot();
+            if (!s)
+                break;
+            s->page = pipe_page_alloc();
+        }
+
+        uint64_t room = KCFG_PAGE_SIZE - s->offset - s->length;
+        uint64_t c = (count - done < room) ? count - done : room;
+        memcpy(s->page->data + s->offset + s->length, (uint8_t*)buffer + done, c);
+        s->length += c;
+        done += c;
     }
-    memcpy((void*)((uint64_t)pipeBuffer + bufferLength), buffer, count);
-    bufferLength += count;
-    return count;
+
+    bufferLength += done;
+    if (done)
+        notifyWatchers();
+    return done;
 }
 
 uint64_t Pipe::read(void* buffer, uint64_t count) {
-    uint64_t c = (count < bufferLength) ? count : bufferLength;
-    memcpy(buffer, pipeBuffer, c);
-    memcpy(pipeBuffer, (void*)((uint64_t)pipeBuffer + c), PIPE_BUFFER_SIZE - c);
-    bufferLength -= c;
-    return c;
+    uint64_t done = 0;
+
+    for (int i = 0; i < used && done < count; i++) {
+        pipe_slot_t* s = &slots[(head + i) % PIPE_SLOTS];
+        uint64_t c = (count - done < s->length) ? count - done : s->length;
+        memcpy((uint8_t*)buffer + done, s->page->data + s->offset, c);
+        done += c;
+    }
+
+    consume(done);
+    if (done)
+        notifyWatchers();
+    return done;
+}
+
+int64_t Pipe::spliceFrom(StreamFile* f, uint64_t count, uint64_t* offset) {
+    struct iovec iov[PIPE_SLOTS];
+    pipe_page_t* pages[PIPE_SLOTS];
+    uint64_t wanted = 0;
+    int n = 0;
+
+    while (wanted < count && used + n < PIPE_SLOTS) {
+        pages[n] = pipe_page_alloc();
+        iov[n].iov_base = pages[n]->data;
+        iov[n].iov_len = (count - wanted < KCFG_PAGE_SIZE) ? count - wanted : KCFG_PAGE_SIZE;
+        wanted += iov[n].iov_len;
+        n++;
+    }
+
+    // The source fills the pages in a single batch
+    int64_t got = offset ? f->preadv(iov, n, *offset) : f->readv(iov, n);
+    if (got > 0 && offset)
+        *offset += got;
+
+    uint64_t left = (got > 0) ? got : 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t c = (left < iov[i].iov_len) ? left : iov[i].iov_len;
+        if (!c) {
+            pipe_page_release(pages[i]);
+            continue;
+        }
+        pipe_slot_t* s = pushSlot();
+        s->page = pages[i];
+        s->length = c;
+        left -= c;
+    }
+
+    if (got > 0) {
+        bufferLength += got;
+        notifyWatchers();
+    }
+    return got;
+}
+
+int64_t Pipe::spliceTo(StreamFile* f, uint64_t count, uint64_t* offset) {
+    struct iovec iov[PIPE_SLOTS];
+    uint64_t wanted = 0;
+    int n = 0;
+
+    for (; n < used && wanted < count; n++) {
+        pipe_slot_t* s = &slots[(head + n) % PIPE_SLOTS];
+        iov[n].iov_base = s->page->data + s->offset;
+        iov[n].iov_len = (count - wanted < s->length) ? count - wanted : s->length;
+        wanted += iov[n].iov_len;
+    }
+
+    int64_t put = offset ? f->pwritev(iov, n, *offset) : f->writev(iov, n);
+    if (put > 0) {
+        if (offset)
+            *offset += put;
+        consume(put);
+        notifyWatchers();
+    }
+    return put;
+}
+
+int64_t Pipe::spliceTo(Pipe* p, uint64_t count) {
+    uint64_t done = 0;
+
+    while (done < count && used) {
+        pipe_slot_t* s = &slots[head];
+        pipe_slot_t* d = p->pushSlot();
+        if (!d)
+            break;
+
+        uint64_t c = (count - done < s->length) ? count - done : s->length;
+        d->page = s->page;
+        d->offset = s->offset;
+        d->length = c;
+        // A partially moved slot leaves the page shared by both pipes
+        if (c < s->length) {
+            s->page->refcount++;
+            s->offset += c;
+            s->length -= c;
+        } else {
+            head = (head + 1) % PIPE_SLOTS;
+            used--;
+        }
+        bufferLength -= c;
+        p->bufferLength += c;
+        done += c;
+    }
+
+    if (done) {
+        notifyWatchers();
+        p->notifyWatchers();
+    }
+    return done;
+}
+
+int64_t Pipe::tee(Pipe* p, uint64_t count) {
+    uint64_t done = 0;
+
+    for (int i = 0; i < used && done < count; i++) {
+        pipe_slot_t* s = &slots[(head + i) % PIPE_SLOTS];
+        pipe_slot_t* d = p->pushSlot();
+        if (!d)
+            break;
+
+        uint64_t c = (count - done < s->length) ? count - done : s->length;
+        s->page->refcount++;
+        d->page = s->page;
+        d->offset = s->offset;
+        d->length = c;
+        p->bufferLength += c;
+        done += c;
+    }
+
+    if (done)
+        p->notifyWatchers();
+    return done;
 }
 
 bool Pipe::canRead() {
     return bufferLength > 0;
 }
 
+bool Pipe::canWrite() {
+    if (used < PIPE_SLOTS)
+        return true;
+    pipe_slot_t* s = &slots[(head + used - 1) % PIPE_SLOTS];
+    return s->page->refcount == 1 && s->offset + s->length < KCFG_PAGE_SIZE;
+}
+
+bool Pipe::notifiesReadiness() {
+    return true;
+}
+
 bool Pipe::isEOF() {
     return closed;
 }
 
 void Pipe::fdClosed() {
     closed = true;
+    notifyWatchers();
+}
+
+Pipe* Pipe::getPipe(bool writing) {
+    return this;
 }
 
 int Pipe::stat(struct stat* stat) {
@@ -3,25 +3,54 @@
 
 #include <lang/lang.h>
 #include <fs/File.h>
+#include <kconfig.h>
 
 
-#define PIPE_BUFFER_SIZE 10240
+#define PIPE_SLOTS 16
+#define PIPE_BUFFER_SIZE (PIPE_SLOTS * KCFG_PAGE_SIZE)
+
+
+struct pipe_page_t {
+    uint8_t* data;
+    int refcount;
+};
+
+struct pipe_slot_t {
+    pipe_page_t* page;
+    uint32_t offset, length;
+};
 
 
 class Pipe : public StreamFile {
 public:
     Pipe();
+    virtual void close();
     virtual int write(const void* buffer, uint64_t count);
     virtual uint64_t read(void* buffer, uint64_t count);
     virtual bool canRead();
+    virtual bool canWrite();
+    virtual bool notifiesReadiness();
     virtual int stat(struct stat* stat);
     virtual bool isEOF();
     virtual void fdClosed();
+    virtual Pipe* getPipe(bool writing);
+
+    // Page-reference transfers for splice/tee/sendfile. Data only gets
+    // copied where it enters or leaves a page; between pipes only page
+    // references move
+    int64_t spliceFrom(StreamFile* f, uint64_t count, uint64_t* offset);
+    int64_t spliceTo(StreamFile* f, uint64_t count, uint64_t* offset);
+    int64_t spliceTo(Pipe* p, uint64_t count);
+    int64_t tee(Pipe* p, uint64_t count);
 private:
+    pipe_slot_t* pushSlot();
+    void consume(uint64_t count);
+
     bool closed;
-    uint8_t pipeBuffer[PIPE_BUFFER_SIZE];
+    pipe_slot_t slots[PIPE_SLOTS];
+    int head, used;
     uint64_t bufferLength;
 };
 
 
-#endif
\ No newline at end of file
+#endif
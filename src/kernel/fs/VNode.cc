@@ -0,0 +1,146 @@
+#include <fs/VNode.h>
+#include <fs/FS.h>
+#include <fs/Writeback.h>
+#include <alloc/malloc.h>
+#include <kconfig.h>
+#include <string.h>
+
+
+VNode::VNode(FS* fs, uint64_t i, int m) {
+    filesystem = fs;
+    id = i;
+    mode = m;
+    size = 0;
+    refcount = 0;
+    maxPages = 0;
+    next = NULL;
+    writer = NULL;
+    dirtyCount = 0;
+    dirtiedAt = 0;
+    nextDirty = NULL;
+    pages = NULL;
+    dirty = NULL;
+    pageSlots = 0;
+    pageCount = 0;
+    clockHand = 0;
+}
+
+void VNode::acquire() {
+    refcount++;
+}
+
+void VNode::release() {
+    if (--refcount)
+        return;
+    dropPages(0, pageSlots * KCFG_PAGE_SIZE);
+    if (pages) {
+        kfree(pages);
+        kfree(dirty);
+    }
+    pages = NULL;
+    dirty = NULL;
+    pageSlots = 0;
+    filesystem->releaseVNode(this);
+}
+
+uint8_t* VNode::getPage(uint64_t index) {
+    if (index >= pageSlots)
+        return NULL;
+    return pages[index];
+}
+
+uint8_t* VNode::addPage(uint64_t index) {
+    if (index >= pageSlots) {
+        uint64_t slots = pageSlots ? pageSlots : 4;
+        while (slots <= index)
+            slots *= 2;
+        uint8_t** p = (uint8_t**)kmalloc(slots * sizeof(uint8_t*));
+        bool* d = (bool*)kmalloc(slots * sizeof(bool));
+        memset(p, 0, slots * sizeof(uint8_t*));
+        memset(d, 0, slots * sizeof(bool));
+        if (pages) {
+            memcpy(p, pages, pageSlots * sizeof(uint8_t*));
+            memcpy(d, dirty, pageSlots * sizeof(bool));
+            kfree(pages);
+            kfree(dirty);
+        }
+        pages = p;
+        dirty = d;
+        pageSlots = slots;
+    }
+
+    if (pages[index])
+        return pages[index];
+
+    // Only clean pages can go. With nothing but dirty pages cached the
+    // cache grows past maxPages; throttling keeps that bounded
+    if (maxPages && pageCount >= maxPages) {
+        for (uint64_t scanned = 0; scanned < pageSlots; scanned++, clockHand++) {
+            uint64_t i = clockHand % pageSlots;
+            if (pages[i] && !dirty[i]) {
+                kfree(pages[i]);
+                pages[i] = NULL;
+                pageCount--;
+                filesystem->unchargePage();
+                clockHand++;
+                break;
+            }
+        }
+    }
+
+    if (!filesystem->chargePage())
+        return NULL;
+    uint8_t* page = pages[index] = (uint8_t*)kvalloc(KCFG_PAGE_SIZE);
+    memset(page, 0, KCFG_PAGE_SIZE);
+    pageCount++;
+    return page;
+}
+
+void VNode::dropPages(uint64_t offset, uint64_t count) {
+    if (!count)
+        return;
+    uint64_t last = (offset + count - 1) / KCFG_PAGE_SIZE;
+    for (uint64_t i = offset / KCFG_PAGE_SIZE; i <= last && i < pageSlots; i++)
+        if (pages[i]) {
+            markClean(i);
+            kfree(pages[i]);
+            pages[i] = NULL;
+            pageCount--;
+            filesystem->unchargePage();
+        }
+}
+
+void VNode::truncate(uint64_t s) {
+    uint64_t keep = (s + KCFG_PAGE_SIZE - 1) / KCFG_PAGE_SIZE;
+    if (keep < pageSlots)
+        dropPages(keep * KCFG_PAGE_SIZE, (pageSlots - keep) * KCFG_PAGE_SIZE);
+    if (s < size && s % KCFG_PAGE_SIZE && getPage(s / KCFG_PAGE_SIZE))
+        memset(pages[s / KCFG_PAGE_SIZE] + s % KCFG_PAGE_SIZE, 0, KCFG_PAGE_SIZE - s % KCFG_PAGE_SIZE);
+    size = s;
+}
+
+void VNode::markDirty(uint64_t index) {
+    if (index >= pageSlots || !pages[index] || dirty[index])
+        return;
+    dirty[index] = true;
+    if (!dirtyCount++)
+        Writeback::get()->add(this);
+    Writeback::get()->dirtyPages++;
+}
+
+void VNode::markClean(uint64_t index) {
+    if (index >= pageSlots || !dirty[index])
+        return;
+    dirty[index] = false;
+    Writeback::get()->dirtyPages--;
+    if (!--dirtyCount)
+        Writeback::get()->remove(this);
+}
+
+bool VNode::isDirty(uint64_t index) {
+    return index < pageSlots && dirty[index];
+}
+
+uint64_t VNode::getPageSlots() {
+    return pageSlots;
+}
@@ -0,0 +1,56 @@
+#ifndef FS_VNODE_H
+#define FS_VNODE_H
+
+#include <lang/lang.h>
+
+
+class FS;
+class File;
+
+// In-memory object shared by every open of one file. Holds the
+// metadata and the page cache, and lives as long as someone holds a
+// reference: open files, and for tmpfs the directory entry itself
+class VNode {
+public:
+    VNode(FS* fs, uint64_t id, int mode);
+    void acquire();
+    void release();
+
+    // Page cache, indexed by file offset / KCFG_PAGE_SIZE. With
+    // maxPages set, adding a page evicts an older one once the limit
+    // is reached; otherwise pages stay until dropped. addPage() returns
+    // NULL when the filesystem refuses another page
+    uint8_t* getPage(uint64_t index);
+    uint8_t* addPage(uint64_t index);
+    void dropPages(uint64_t offset, uint64_t count);
+    void truncate(uint64_t size);
+
+    // Dirty pages are newer than the disk. They are never evicted,
+    // and go back through the writer's sync() when the flusher, a
+    // throttled writer or fsync gets to them
+    void markDirty(uint64_t index);
+    void markClean(uint64_t index);
+    bool isDirty(uint64_t index);
+    uint64_t getPageSlots();
+
+    FS* filesystem;
+    uint64_t id;
+    int mode;
+    uint64_t size;
+    int refcount;
+    uint64_t maxPages;
+    VNode* next;
+
+    File* writer;
+    uint64_t dirtyCount;
+    uint64_t dirtiedAt;
+    VNode* nextDirty;
+private:
+    uint8_t** pages;
+    bool* dirty;
+    uint64_t pageSlots;
+    uint64_t pageCount;
+    uint64_t clockHand;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include <fs/Writeback.h>
+#include <fs/File.h>
+#include <fs/VNode.h>
+#include <core/CPU.h>
+#include <core/Scheduler.h>
+#include <core/Wait.h>
+#include <hardware/pit/PIT.h>
+#include <kconfig.h>
+
+
+Writeback::Writeback() {
+    dirtyPages = 0;
+    dirty = NULL;
+    lastFlush = 0;
+}
+
+void Writeback::add(VNode* vnode) {
+    // Sorted by id, which follows the on-disk position of the
+    // directory entry closely enough to keep batches in disk order
+    vnode->dirtiedAt = PIT::get()->getTime();
+    VNode** p = &dirty;
+    while (*p && (*p)->id < vnode->id)
+        p = &(*p)->nextDirty;
+    vnode->nextDirty = *p;
+    *p = vnode;
+}
+
+void Writeback::remove(VNode* vnode) {
+    for (VNode** p = &dirty; *p; p = &(*p)->nextDirty)
+        if (*p == vnode) {
+            *p = vnode->nextDirty;
+            break;
+        }
+    vnode->nextDirty = NULL;
+}
+
+void Writeback::flush(uint64_t target, uint64_t age) {
+    uint64_t now = PIT::get()->getTime();
+    VNode* v = dirty;
+    while (v) {
+        VNode* next = v->nextDirty;
+        if (v->writer && (dirtyPages > target || now - v->dirtiedAt >= age))
+            v->writer->sync();
+        v = next;
+    }
+    lastFlush = now;
+}
+
+void Writeback::throttle() {
+    if (dirtyPages > KCFG_DIRTY_LIMIT_PAGES)
+        flush(KCFG_DIRTY_BACKGROUND_PAGES, KCFG_DIRTY_EXPIRE_MS);
+}
+
+void Writeback::sync() {
+    flush(0, 0);
+}
+
+bool Writeback::needsFlush() {
+    if (dirtyPages > KCFG_DIRTY_BACKGROUND_PAGES)
+        return true;
+    return dirty && PIT::get()->getTime() - lastFlush >= KCFG_WRITEBACK_INTERVAL_MS;
+}
+
+void Writeback::worker(void*) {
+    for (;;) {
+        Scheduler::get()->getActiveThread()->wait(new WaitForWriteback());
+        Scheduler::get()->pause();
+        Writeback::get()->flush(KCFG_DIRTY_BACKGROUND_PAGES, KCFG_DIRTY_EXPIRE_MS);
+        Scheduler::get()->resume();
+        CPU::STI();
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef FS_WRITEBACK_H
+#define FS_WRITEBACK_H
+
+#include <lang/lang.h>
+#include <lang/Singleton.h>
+
+
+class VNode;
+
+// Keeps track of vnodes holding dirty pages and gets them back to
+// disk: the flusher thread writes back data older than
+// KCFG_DIRTY_EXPIRE_MS and whatever it takes to get below
+// KCFG_DIRTY_BACKGROUND_PAGES, and writers that push the total past
+// KCFG_DIRTY_LIMIT_PAGES do the same work themselves before returning
+class Writeback : public Singleton<Writeback> {
+public:
+    Writeback();
+    void add(VNode* vnode);
+    void remove(VNode* vnode);
+    void throttle();
+    void sync();
+    bool needsFlush();
+    static void worker(void*);
+
+    uint64_t dirtyPages;
+private:
+    void flush(uint64_t target, uint64_t age);
+    VNode* dirty;
+    uint64_t lastFlush;
+};
+
+#endif
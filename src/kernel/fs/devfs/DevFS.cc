@@ -1,5 +1,7 @@
 #include <fs/devfs/DevFS.h>
+#include <fs/devfs/KernelLog.h>
 #include <fs/devfs/RandomSource.h>
+#include <fs/devfs/SerialTTY.h>
 #include <fs/File.h>
 #include <core/Process.h>
 #include <core/Scheduler.h>
@@ -8,6 +10,42 @@
 #include <errno.h>
 
 
+static StreamFile* open_tty(DevFS* fs) {
+    return Scheduler::get()->getActiveThread()->process->pty->openSlave();
+}
+
+static StreamFile* open_null(DevFS* fs) {
+    return new NullSource(fs);
+}
+
+static StreamFile* open_random(DevFS* fs) {
+    return new RandomSource(fs);
+}
+
+static StreamFile* open_kmsg(DevFS* fs) {
+    return new KernelLog(fs);
+}
+
+static StreamFile* open_serial(DevFS* fs) {
+    return new SerialTTY(fs);
+}
+
+// Every entry DevFS serves, for both open and stat
+static const struct {
+    const char* name;
+    StreamFile* (*open)(DevFS* fs);
+} devices[] = {
+    { "/tty", open_tty },
+    { "/console", open_tty },
+    { "/null", open_null },
+    { "/random", open_random },
+    { "/urandom", open_random },
+    { "/kmsg", open_kmsg },
+    { "/ttyS0", open_serial },
+    { NULL, NULL }
+};
+
+
 DevFS::DevFS() {
 }
 
@@ -16,14 +54,9 @@ char* DevFS::getName() {
 }
 
 StreamFile* DevFS::open(char* path, int flags) {
-    if (strcmp(path, "/tty") == 0 || strcmp(path, "/console") == 0)
-        return Scheduler::get()->getActiveThread()->process->pty->openSlave();
-    if (strcmp(path, "/null") == 0)
-        return new NullSource("/null", this);
-    if (strcmp(path, "/random") == 0)
-        return new RandomSource("/random", this);
-    if (strcmp(path, "/urandom") == 0)
-        return new RandomSource("/urandom", this);
+    for (int i = 0; devices[i].name; i++)
+        if (strcmp(path, devices[i].name) == 0)
+            return devices[i].open(this);
     klog('w', "DevFS entry not found: %s", path);
     seterr(ENOENT);
     return NULL;
@@ -34,7 +67,22 @@ Directory* DevFS::opendir(char* path) {
     return NULL;
 }
 
-NullSource::NullSource(const char* path, FS* fs) : StreamFile(path, fs) {}
+int DevFS::stat(char* path, struct stat* stat) {
+    stat_init(stat);
+    if (!*path || strcmp(path, "/") == 0) {
+        stat->st_mode |= S_IFDIR;
+        return 0;
+    }
+    for (int i = 0; devices[i].name; i++)
+        if (strcmp(path, devices[i].name) == 0) {
+            stat->st_mode |= S_IFCHR;
+            return 0;
+        }
+    seterr(ENOENT);
+    return -1;
+}
+
+NullSource::NullSource(FS* fs) : StreamFile(fs) {}
 
 uint64_t NullSource::read(void* buffer, uint64_t count) {
     return 0;
@@ -13,12 +13,13 @@ public:
     virtual char* getName();
     virtual StreamFile* open(char* path, int flags);
     virtual Directory* opendir(char* path);
+    virtual int stat(char* path, struct stat* stat);
 };  
 
 
 class NullSource : public StreamFile {
 public:
-    NullSource(const char* path, FS*);
+    NullSource(FS*);
     virtual uint64_t read(void* buffer, uint64_t count);
     virtual void close();
     virtual bool canRead();
@@ -0,0 +1,45 @@
+#include <fs/devfs/KernelLog.h>
+#include <string.h>
+#include <kutil.h>
+
+
+KernelLog::KernelLog(FS* fs) : StreamFile(fs) {
+    seq = 1;
+}
+
+int KernelLog::write(const void* buffer, uint64_t count) {
+    char text[KCFG_LOG_LINE_SIZE];
+    uint64_t len = (count < KCFG_LOG_LINE_SIZE - 1) ? count : KCFG_LOG_LINE_SIZE - 1;
+    memcpy(text, buffer, len);
+    while (len > 0 && text[len - 1] == '\n')
+        len--;
+    text[len] = 0;
+    klog('i', "%s", text);
+    return count;
+}
+
+uint64_t KernelLog::read(void* buffer, uint64_t count) {
+    klog_record_t r;
+    if (!klog_read(&seq, &r))
+        return 0;
+
+    char line[KCFG_LOG_LINE_SIZE + 32];
+    uint64_t len = klog_format(&r, line, sizeof(line));
+    if (len > count)
+        len = count;
+    memcpy(buffer, line, len);
+    return len;
+}
+
+void KernelLog::close() {
+}
+
+bool KernelLog::canRead() {
+    return seq <= klog_last_seq();
+}
+
+int KernelLog::stat(struct stat* stat) {
+    File::stat(stat);
+    stat->st_mode |= S_IFCHR;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef FS_DEVFS_KERNELLOG_H
+#define FS_DEVFS_KERNELLOG_H
+
+#include <fs/File.h>
+#include <fs/FS.h>
+
+
+class KernelLog : public StreamFile {
+public:
+    KernelLog(FS*);
+    virtual int write(const void* buffer, uint64_t count);
+    virtual uint64_t read(void* buffer, uint64_t count);
+    virtual void close();
+    virtual bool canRead();
+    virtual int stat(struct stat* stat);
+private:
+    uint64_t seq;
+};
+
+#endif
@@ -15,9 +15,25 @@ PTYSlave* PTY::openSlave() {
     return new PTYSlave(this);
 }
 
+void PTY::addRelays(PTYRelay* relays) {
+    masterReadPipe.addWatcher(&relays[0]);
+    masterWritePipe.addWatcher(&relays[1]);
+}
+
+void PTY::removeRelays(PTYRelay* relays) {
+    masterReadPipe.removeWatcher(&relays[0]);
+    masterWritePipe.removeWatcher(&relays[1]);
+}
+
+
+void PTYRelay::fileReady() {
+    watchers_notify(*watchers);
+}
+
 
-PTYMaster::PTYMaster(PTY* p) : StreamFile(0, 0) {
+PTYMaster::PTYMaster(PTY* p) : StreamFile(0) {
     pty = p;
+    relays[0].watchers = relays[1].watchers = &watchers;
 }
 
 int PTYMaster::write(const void* buffer, uint64_t count) {
@@ -32,10 +48,35 @@ bool PTYMaster::canRead() {
     return pty->masterReadPipe.canRead();
 }
 
+bool PTYMaster::canWrite() {
+    return pty->masterWritePipe.canWrite();
+}
+
+bool PTYMaster::notifiesReadiness() {
+    return true;
+}
 
+void PTYMaster::addWatcher(FileWatcher* w) {
+    if (!watchers)
+        pty->addRelays(relays);
+    StreamFile::addWatcher(w);
+}
 
-PTYSlave::PTYSlave(PTY* p) : StreamFile(0, 0) {
+void PTYMaster::removeWatcher(FileWatcher* w) {
+    StreamFile::removeWatcher(w);
+    if (!watchers)
+        pty->removeRelays(relays);
+}
+
+Pipe* PTYMaster::getPipe(bool writing) {
+    return writing ? &pty->masterWritePipe : &pty->masterReadPipe;
+}
+
+
+
+PTYSlave::PTYSlave(PTY* p) : StreamFile(0) {
     pty = p;
+    relays[0].watchers = relays[1].watchers = &watchers;
 }
 
 int PTYSlave::write(const void* buffer, uint64_t count) {
@@ -50,6 +91,30 @@ bool PTYSlave::canRead() {
     return pty->masterWritePipe.canRead();
 }
 
+bool PTYSlave::canWrite() {
+    return pty->masterReadPipe.canWrite();
+}
+
+bool PTYSlave::notifiesReadiness() {
+    return true;
+}
+
+void PTYSlave::addWatcher(FileWatcher* w) {
+    if (!watchers)
+        pty->addRelays(relays);
+    StreamFile::addWatcher(w);
+}
+
+void PTYSlave::removeWatcher(FileWatcher* w) {
+    StreamFile::removeWatcher(w);
+    if (!watchers)
+        pty->removeRelays(relays);
+}
+
+Pipe* PTYSlave::getPipe(bool writing) {
+    return writing ? &pty->masterReadPipe : &pty->masterWritePipe;
+}
+
 int PTYSlave::stat(struct stat* stat) {
     File::stat(stat);
     stat->st_mode |= S_IFCHR;
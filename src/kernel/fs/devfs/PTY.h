@@ -8,6 +8,7 @@
 
 class PTYSlave;
 class PTYMaster;
+class PTYRelay;
 
 
 class PTY {
@@ -16,19 +17,36 @@ public:
 
     PTYMaster* openMaster();
     PTYSlave* openSlave();
+    void addRelays(PTYRelay* relays);
+    void removeRelays(PTYRelay* relays);
 
     Pipe masterWritePipe;
     Pipe masterReadPipe;
 };
 
+// Forwards one pipe's readiness changes to the watchers of a PTY end.
+// Each end has one per pipe while it is watched, since reading and
+// writing it depend on different pipes and watcher lists are intrusive
+class PTYRelay : public FileWatcher {
+public:
+    virtual void fileReady();
+    FileWatcher** watchers;
+};
+
 class PTYMaster : public StreamFile {
 public:
     PTYMaster(PTY*);
     virtual int write(const void* buffer, uint64_t count);
     virtual uint64_t read(void* buffer, uint64_t count);
     virtual bool canRead();
+    virtual bool canWrite();
+    virtual bool notifiesReadiness();
+    virtual void addWatcher(FileWatcher* w);
+    virtual void removeWatcher(FileWatcher* w);
+    virtual Pipe* getPipe(bool writing);
 private:
     PTY* pty;
+    PTYRelay relays[2];
 };
 
 class PTYSlave : public StreamFile {
@@ -37,9 +55,15 @@ public:
     virtual int write(const void* buffer, uint64_t count);
     virtual uint64_t read(void* buffer, uint64_t count);
     virtual bool canRead();
+    virtual bool canWrite();
+    virtual bool notifiesReadiness();
+    virtual void addWatcher(FileWatcher* w);
+    virtual void removeWatcher(FileWatcher* w);
+    virtual Pipe* getPipe(bool writing);
     virtual int stat(struct stat* stat);
 private:
     PTY* pty;
+    PTYRelay relays[2];
 };
 
 
@@ -1,7 +1,7 @@
 #include <fs/devfs/RandomSource.h>
 #include <stdlib.h>
 
-RandomSource::RandomSource(const char* path, FS* fs) : StreamFile(path, fs) {}
+RandomSource::RandomSource(FS* fs) : StreamFile(fs) {}
 
 uint64_t RandomSource::read(void* buffer, uint64_t count) {
     for (uint64_t i = 0; i < count; i++)
@@ -7,7 +7,7 @@
 
 class RandomSource : public StreamFile {
 public:
-    RandomSource(const char* path, FS*);
+    RandomSource(FS*);
     virtual uint64_t read(void* buffer, uint64_t count) ;
     virtual void close();
     virtual bool canRead();
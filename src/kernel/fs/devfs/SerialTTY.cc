@@ -0,0 +1,38 @@
+#include <fs/devfs/SerialTTY.h>
+#include <hardware/serial/Serial.h>
+
+
+SerialTTY::SerialTTY(FS* fs) : StreamFile(fs) {}
+
+int SerialTTY::write(const void* buffer, uint64_t count) {
+    return Serial::get()->write(buffer, count);
+}
+
+uint64_t SerialTTY::read(void* buffer, uint64_t count) {
+    return Serial::get()->read(buffer, count);
+}
+
+void SerialTTY::close() {
+}
+
+bool SerialTTY::canRead() {
+    return Serial::get()->canRead();
+}
+
+bool SerialTTY::notifiesReadiness() {
+    return true;
+}
+
+void SerialTTY::addWatcher(FileWatcher* w) {
+    watchers_add(&Serial::get()->watchers, w);
+}
+
+void SerialTTY::removeWatcher(FileWatcher* w) {
+    watchers_remove(&Serial::get()->watchers, w);
+}
+
+int SerialTTY::stat(struct stat* stat) {
+    File::stat(stat);
+    stat->st_mode |= S_IFCHR;
+    return 0;
+}
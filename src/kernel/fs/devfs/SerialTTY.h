@@ -0,0 +1,21 @@
+#ifndef FS_DEVFS_SERIALTTY_H
+#define FS_DEVFS_SERIALTTY_H
+
+#include <fs/File.h>
+#include <fs/FS.h>
+
+
+class SerialTTY : public StreamFile {
+public:
+    SerialTTY(FS*);
+    virtual int write(const void* buffer, uint64_t count);
+    virtual uint64_t read(void* buffer, uint64_t count);
+    virtual void close();
+    virtual bool canRead();
+    virtual bool notifiesReadiness();
+    virtual void addWatcher(FileWatcher* w);
+    virtual void removeWatcher(FileWatcher* w);
+    virtual int stat(struct stat* stat);
+};
+
+#endif
@@ -1,13 +1,39 @@
 #include <fs/fat32/FAT32FS.h>
+#include <fs/Writeback.h>
+#include <alloc/malloc.h>
+#include <kconfig.h>
 #include <fcntl.h>
 #include <kutil.h>
 #include <string.h>
 #include <errno.h>
 
 
+// f_open reports directories, including the root, as missing files
+static bool is_directory(char* path) {
+    while (*path == '/')
+        path++;
+    if (!*path)
+        return true;
+
+    FILINFO fi;
+    fi.lfname = NULL;
+    fi.lfsize = 0;
+    return f_stat(path, &fi) == FR_OK && (fi.fattrib & AM_FDIR);
+}
+
+// The directory entry identifies the file across opens
+static uint64_t dirent_id(uint64_t sector, uint64_t index) {
+    return sector * (_MAX_SS / 32) + index;
+}
+
+
 FAT32FS::FAT32FS() {
     fs = new FATFS();
     f_mount(0, fs);
+    uint64_t pages = KCFG_READAHEAD_MAX_PAGES;
+    if (pages < KCFG_WRITEBACK_BATCH_PAGES)
+        pages = KCFG_WRITEBACK_BATCH_PAGES;
+    staging = (uint8_t*)kmalloc(pages * KCFG_PAGE_SIZE);
 }
 
 char* FAT32FS::getName() {
@@ -29,12 +55,35 @@ StreamFile* FAT32FS::open(char* path, int flags) {
 //klog('i', "FRESULT = %i", result);
     if (result == FR_NO_FILE || result == FR_NO_PATH || result == FR_INVALID_NAME) {
         delete fil;
-        seterr(ENOENT);
+        seterr(is_directory(path) ? EISDIR : ENOENT);
+        return NULL;
+    } else if (result != FR_OK) {
+        delete fil;
+        if (result == FR_LOCKED)
+            seterr(EBUSY);
+        else if (result == FR_TOO_MANY_OPEN_FILES)
+            seterr(ENFILE);
+        else if (result == FR_DENIED)
+            seterr(EACCES);
+        else
+            seterr(EIO);
         return NULL;
     }
 
-    StreamFile* f = new FAT32File(path, this, fil);
+    uint64_t id = dirent_id(fil->dir_sect, (fil->dir_ptr - fil->fs->win) / 32);
+    VNode* v = findVNode(id);
+    if (!v) {
+        v = new VNode(this, id, S_IFREG);
+        v->size = f_size(fil);
+        v->maxPages = KCFG_VNODE_CACHE_PAGES;
+        addVNode(v);
+    } else if (mode & FA_CREATE_ALWAYS)
+        v->truncate(0);
+
+    StreamFile* f = new FAT32File(this, v, fil);
     f->flags = flags;
+    if (mode & FA_WRITE)
+        v->writer = f;
     return f;
 }
 
@@ -48,62 +97,443 @@ Directory* FAT32FS::opendir(char* path) {
         return NULL;
     }
 
-    return new FAT32Directory(path, this, dir);
+    return new FAT32Directory(this, dir);
 }
 
 void FAT32FS::rename(char* opath, char* npath) {
     int result = f_rename(opath, npath);
     if (result == FR_NO_FILE || result == FR_NO_PATH) {
         seterr(ENOENT);
+    } else if (result == FR_LOCKED) {
+        seterr(EBUSY);
     }
 }
 
 void FAT32FS::unlink(char* path) {
+    // f_unlink takes empty directories too, those go through rmdir
+    if (is_directory(path)) {
+        seterr(EISDIR);
+        return;
+    }
     int result = f_unlink(path);
     if (result == FR_NO_FILE || result == FR_NO_PATH) {
         seterr(ENOENT);
+    } else if (result == FR_LOCKED) {
+        seterr(EBUSY);
     }
 }
 
+void FAT32FS::rmdir(char* path) {
+    FILINFO fi;
+    fi.lfname = NULL;
+    fi.lfsize = 0;
+    if (f_stat(path, &fi) == FR_OK && !(fi.fattrib & AM_FDIR)) {
+        seterr(ENOTDIR);
+        return;
+    }
 
-FAT32File::FAT32File(const char* p, FAT32FS* fs, FIL* f) : StreamFile(p, fs) {
-    fil = f;
-    eof = false;
+    int result = f_unlink(path);
+    if (result == FR_NO_FILE || result == FR_NO_PATH) {
+        seterr(ENOENT);
+    } else if (result == FR_DENIED) {
+        seterr(ENOTEMPTY);
+    } else if (result == FR_LOCKED || result == FR_INVALID_NAME) {
+        seterr(EBUSY); // open, or the root
+    } else if (result != FR_OK) {
+        seterr(EIO);
+    }
 }
 
-FAT32File::~FAT32File() {
-    delete path;
+int FAT32FS::stat(char* path, struct stat* stat) {
+    stat_init(stat);
+
+    char* p = path;
+    while (*p == '/')
+        p++;
+    if (!*p) {
+        stat->st_mode |= S_IFDIR;
+        return 0;
+    }
+
+    FILINFO fi;
+    fi.lfname = NULL;
+    fi.lfsize = 0;
+    int result = f_stat(path, &fi);
+    if (result != FR_OK) {
+        seterr((result == FR_NO_FILE || result == FR_NO_PATH || result == FR_INVALID_NAME) ? ENOENT : EIO);
+        return -1;
+    }
+
+    stat->st_ino = dirent_id(fi.dsect, fi.dindex);
+    if (fi.fattrib & AM_FDIR)
+        stat->st_mode |= S_IFDIR;
+    else {
+        // An open file's size may be ahead of its directory entry
+        VNode* v = findVNode(stat->st_ino);
+        stat->st_mode |= S_IFREG;
+        stat->st_size = v ? v->size : fi.fsize;
+        stat->st_blocks = (stat->st_size + 511) / 512;
+    }
+    return 0;
+}
+
+bool FAT32FS::cacheDentries() {
+    return true;
+}
+
+bool FAT32FS::caseInsensitive() {
+    return true;
+}
+
+void FAT32FS::mkdir(char* path, int mode) {
+    int result = f_mkdir(path);
+    if (result == FR_NO_PATH) {
+        seterr(ENOENT);
+    } else if (result == FR_EXIST) {
+        seterr(EEXIST);
+    } else if (result != FR_OK) {
+        seterr(EIO);
+    }
+}
+
+
+FAT32File::FAT32File(FAT32FS* fs, VNode* v, FIL* f) : StreamFile(fs, v) {
+    fil = f;
+    eof = false;
+    position = 0;
+    nextRead = 0;
+    readahead = 0;
+    linkMap = NULL;
+    linkMapSize = 0;
 }
 
 
 int FAT32File::write(const void* buffer, uint64_t count) {
-    uint32_t num;
-    f_write(fil, buffer, count, &num);
-    return num;
+    struct iovec iov = { (void*)buffer, count };
+    return writev(&iov, 1);
 }
 
 uint64_t FAT32File::read(void* buffer, uint64_t count) {
-    uint32_t num;
-    f_read(fil, buffer, count, &num);
-    if (num == 0)
-        eof = true;
-    return num;
+    struct iovec iov = { buffer, count };
+    return readv(&iov, 1);
 }
 
 uint64_t FAT32File::seek(uint64_t offset, uint64_t whence) {
-    if (whence == SEEK_SET) {
-        f_lseek(fil, offset);
-        return f_tell(fil);
+    if (whence == SEEK_SET)
+        position = offset;
+    else if (whence == SEEK_CUR)
+        position += offset;
+    else if (whence == SEEK_END)
+        position = vnode->size + offset;
+    else
+        return (uint64_t)-1;
+    return position;
+}
+
+
+void FAT32File::seekTo(uint64_t offset) {
+    // Past the first cluster, seeks go through a map of the file's
+    // cluster runs instead of walking the FAT chain from the start.
+    // FatFs clips fast seeks at the file size and cannot extend the
+    // chain through the map, so seeks to the end and beyond take the
+    // normal path
+    if (offset >= f_size(fil))
+        dropLinkMap();
+    else if (!fil->cltbl && offset > (uint64_t)fil->fs->csize * sizeof(fil->fs->win))
+        buildLinkMap();
+    f_lseek(fil, offset);
+}
+
+void FAT32File::buildLinkMap() {
+    if (!linkMapSize) {
+        linkMapSize = 32;
+        linkMap = (DWORD*)kmalloc(linkMapSize * sizeof(DWORD));
+    }
+
+    uint32_t position = f_tell(fil);
+    for (;;) {
+        linkMap[0] = linkMapSize;
+        fil->cltbl = linkMap;
+        FRESULT r = f_lseek(fil, CREATE_LINKMAP);
+        if (r == FR_OK)
+            break;
+        fil->cltbl = NULL;
+        if (r != FR_NOT_ENOUGH_CORE)
+            return;
+
+        // linkMap[0] holds the number of items the map needs
+        uint64_t needed = linkMap[0];
+        kfree(linkMap);
+        linkMapSize = needed;
+        linkMap = (DWORD*)kmalloc(linkMapSize * sizeof(DWORD));
+    }
+    f_lseek(fil, position);
+}
+
+void FAT32File::dropLinkMap() {
+    // The map goes stale once the cluster chain grows
+    fil->cltbl = NULL;
+}
+
+uint64_t FAT32File::cachedRead(void* buffer, uint64_t count, uint64_t offset) {
+    // Reads are served from the vnode's page cache, so every opener of
+    // the file shares the pages that any of them brought in
+    uint64_t done = 0;
+    while (done < count && offset + done < vnode->size) {
+        uint64_t index = (offset + done) / KCFG_PAGE_SIZE;
+        uint64_t pageOffset = (offset + done) % KCFG_PAGE_SIZE;
+        uint64_t length = vnode->size - index * KCFG_PAGE_SIZE;
+        if (length > KCFG_PAGE_SIZE)
+            length = KCFG_PAGE_SIZE;
+
+        uint8_t* page = vnode->getPage(index);
+        if (!page) {
+            page = fill(index, readahead ? readahead : 1);
+            if (readahead && readahead < KCFG_READAHEAD_MAX_PAGES)
+                readahead *= 2;
+            if (!page)
+                break;
+        }
+
+        uint64_t c = length - pageOffset;
+        if (c > count - done)
+            c = count - done;
+        memcpy((uint8_t*)buffer + done, page + pageOffset, c);
+        done += c;
+    }
+    return done;
+}
+
+uint64_t FAT32File::cachedWrite(const void* buffer, uint64_t count, uint64_t offset) {
+    // Writes only dirty pages in the vnode's cache; the disk catches up
+    // at writeback. Parts of a page the write does not cover are read
+    // in first, unless they lie past the end of the file on disk
+    uint64_t done = 0;
+    while (done < count) {
+        uint64_t at = offset + done;
+        uint64_t index = at / KCFG_PAGE_SIZE;
+        uint64_t pageOffset = at % KCFG_PAGE_SIZE;
+        uint64_t c = KCFG_PAGE_SIZE - pageOffset;
+        if (c > count - done)
+            c = count - done;
+
+        uint8_t* page = vnode->getPage(index);
+        if (!page) {
+            uint64_t disk = f_size(fil);
+            if (index * KCFG_PAGE_SIZE < disk && (pageOffset || at + c < disk))
+                page = fill(index, 1);
+            else
+                page = vnode->addPage(index);
+            if (!page)
+                break;
+        }
+
+        memcpy(page + pageOffset, (uint8_t*)buffer + done, c);
+        vnode->markDirty(index);
+        done += c;
+        if (at + c > vnode->size)
+            vnode->size = at + c;
+    }
+    return done;
+}
+
+uint8_t* FAT32File::fill(uint64_t index, uint64_t count) {
+    // A sequential reader gets the following pages in the same f_read,
+    // which FatFs turns into multi-sector transfers per cluster.
+    // Disk I/O sleeps, so the data lands in the staging buffer and
+    // pages only appear once they are complete; pages that another
+    // thread added in the meantime are newer and are left alone
+    FAT32FS* volume = (FAT32FS*)filesystem;
+    volume->stagingLock.lock();
+
+    uint8_t* existing = vnode->getPage(index);
+    if (existing) {
+        volume->stagingLock.unlock();
+        return existing;
     }
-    if (whence == SEEK_CUR) {
-        f_lseek(fil, f_tell(fil) + offset);
-        return f_tell(fil);
+
+    // Past what writeback has put on disk so far the file reads as
+    // zeroes
+    uint64_t disk = f_size(fil);
+    if (index * KCFG_PAGE_SIZE >= disk) {
+        volume->stagingLock.unlock();
+        return vnode->addPage(index);
     }
-    if (whence == SEEK_END) {
-        f_lseek(fil, f_size(fil) + offset);
-        return f_tell(fil);
+
+    uint64_t last = (disk - 1) / KCFG_PAGE_SIZE;
+    if (index + count - 1 > last)
+        count = last - index + 1;
+    for (uint64_t i = 1; i < count; i++)
+        if (vnode->getPage(index + i)) {
+            count = i;
+            break;
+        }
+
+    uint64_t length = disk - index * KCFG_PAGE_SIZE;
+    if (length > count * KCFG_PAGE_SIZE)
+        length = count * KCFG_PAGE_SIZE;
+
+    uint32_t num = 0;
+    seekTo(index * KCFG_PAGE_SIZE);
+    f_read(fil, volume->staging, length, &num);
+
+    // Only pages that came back whole are cached. The requested page
+    // goes in last so that eviction cannot take it
+    uint8_t* page = NULL;
+    for (uint64_t i = count; i-- > 0;) {
+        uint64_t start = i * KCFG_PAGE_SIZE;
+        uint64_t size = length - start;
+        if (size > KCFG_PAGE_SIZE)
+            size = KCFG_PAGE_SIZE;
+        if (num < start + size)
+            continue;
+        page = vnode->getPage(index + i);
+        if (!page) {
+            page = vnode->addPage(index + i);
+            if (page)
+                memcpy(page, volume->staging + start, size);
+        }
     }
-    return (uint64_t)-1;
+    volume->stagingLock.unlock();
+    return (num >= (length < KCFG_PAGE_SIZE ? length : KCFG_PAGE_SIZE)) ? page : NULL;
+}
+
+bool FAT32File::writeback() {
+    // Runs of dirty pages go out in ascending order, up to
+    // KCFG_WRITEBACK_BATCH_PAGES per f_write, so FatFs can hand whole
+    // clusters to the disk at once
+    FAT32FS* volume = (FAT32FS*)filesystem;
+    uint8_t* staging = volume->staging;
+    volume->stagingLock.lock();
+
+    for (uint64_t index = 0; index < vnode->getPageSlots() && vnode->dirtyCount; index++) {
+        if (!vnode->isDirty(index))
+            continue;
+        uint64_t start = index * KCFG_PAGE_SIZE;
+
+        // FAT has no holes: whatever lies between the end of the file
+        // on disk and this run was never written and goes out as zeroes
+        uint32_t n = 0;
+        while (f_size(fil) < start) {
+            uint64_t gap = start - f_size(fil);
+            if (gap > KCFG_WRITEBACK_BATCH_PAGES * KCFG_PAGE_SIZE)
+                gap = KCFG_WRITEBACK_BATCH_PAGES * KCFG_PAGE_SIZE;
+            memset(staging, 0, gap);
+            dropLinkMap();
+            f_lseek(fil, f_size(fil));
+            if (f_write(fil, staging, gap, &n) != FR_OK || n < gap) {
+                volume->stagingLock.unlock();
+                return false;
+            }
+        }
+
+        // Writing the gap slept, so the run is measured only now. Its
+        // pages are clean from the moment they are copied: writes that
+        // land while f_write sleeps dirty them again for the next pass
+        if (!vnode->isDirty(index) || start >= vnode->size)
+            continue;
+        uint64_t count = 1;
+        while (count < KCFG_WRITEBACK_BATCH_PAGES && vnode->isDirty(index + count))
+            count++;
+
+        uint64_t length = vnode->size - start;
+        if (length > count * KCFG_PAGE_SIZE)
+            length = count * KCFG_PAGE_SIZE;
+
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t size = length - i * KCFG_PAGE_SIZE;
+            if (size > KCFG_PAGE_SIZE)
+                size = KCFG_PAGE_SIZE;
+            memcpy(staging + i * KCFG_PAGE_SIZE, vnode->getPage(index + i), size);
+            vnode->markClean(index + i);
+        }
+
+        if (start + length > f_size(fil)) {
+            dropLinkMap();
+            f_lseek(fil, start);
+        } else
+            seekTo(start);
+        if (f_write(fil, staging, length, &n) != FR_OK || n < length) {
+            // Put back what did not reach the disk. Clean pages may have
+            // been evicted meanwhile, the staging copy is still current
+            for (uint64_t i = 0; i < count; i++) {
+                uint64_t size = length - i * KCFG_PAGE_SIZE;
+                if (size > KCFG_PAGE_SIZE)
+                    size = KCFG_PAGE_SIZE;
+                uint8_t* page = vnode->getPage(index + i);
+                if (!page) {
+                    page = vnode->addPage(index + i);
+                    if (page)
+                        memcpy(page, staging + i * KCFG_PAGE_SIZE, size);
+                }
+                vnode->markDirty(index + i);
+            }
+            volume->stagingLock.unlock();
+            return false;
+        }
+        index += count - 1;
+    }
+    volume->stagingLock.unlock();
+    return true;
+}
+
+int64_t FAT32File::transfer(const struct iovec* iov, int count, uint64_t offset, bool write) {
+    // Both directions go through the vnode's page cache, and the whole
+    // batch runs against this file's FIL, so FatFs walks the cluster
+    // chain and sector window once instead of once per syscall
+    int64_t total = 0;
+    if (!write) {
+        if (offset != nextRead)
+            readahead = 0;
+        else if (!readahead)
+            readahead = KCFG_READAHEAD_MIN_PAGES;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t num;
+        if (write)
+            num = cachedWrite(iov[i].iov_base, iov[i].iov_len, offset + total);
+        else
+            num = cachedRead(iov[i].iov_base, iov[i].iov_len, offset + total);
+        total += num;
+        if (num < iov[i].iov_len)
+            break;
+    }
+    if (write)
+        Writeback::get()->throttle();
+    else
+        nextRead = offset + total;
+    return total;
+}
+
+int64_t FAT32File::readv(const struct iovec* iov, int count) {
+    int64_t c = transfer(iov, count, position, false);
+    position += c;
+    if (c == 0)
+        eof = true;
+    return c;
+}
+
+int64_t FAT32File::writev(const struct iovec* iov, int count) {
+    int64_t c = transfer(iov, count, position, true);
+    position += c;
+    return c;
+}
+
+int64_t FAT32File::preadv(const struct iovec* iov, int count, uint64_t offset) {
+    return transfer(iov, count, offset, false);
+}
+
+int64_t FAT32File::pwritev(const struct iovec* iov, int count, uint64_t offset) {
+    return transfer(iov, count, offset, true);
+}
+
+int FAT32File::sync() {
+    bool ok = writeback();
+    if (f_sync(fil) != FR_OK || !ok) {
+        seterr(EIO);
+        return -1;
+    }
+    return 0;
 }
 
 
@@ -112,8 +542,15 @@ bool FAT32File::isEOF() {
 }
 
 void FAT32File::close() {
+    if (vnode->writer == this) {
+        writeback();
+        vnode->writer = NULL;
+    }
     f_close(fil);
     delete fil;
+    if (linkMap)
+        kfree(linkMap);
+    StreamFile::close();
 }
 
 bool FAT32File::canRead() {
@@ -122,16 +559,14 @@ bool FAT32File::canRead() {
 
 int FAT32File::stat(struct stat* stat) {
     File::stat(stat);
-    //FILINFO fi;
-    //fi.lfsize = 0;
-    //f_stat(path, &fi);
-    stat->st_size = f_size(fil);
+    stat->st_ino = vnode->id;
+    stat->st_size = vnode->size;
     stat->st_mode |= S_IFREG;
     return 0; 
 }
 
 
-FAT32Directory::FAT32Directory(const char* path, FAT32FS* f, FDIR* d) : Directory(path, f) {
+FAT32Directory::FAT32Directory(FAT32FS* f, FDIR* d) : Directory(f) {
     dir = d;
 }
 
@@ -155,6 +590,10 @@ struct dirent* FAT32Directory::read() {
         return NULL;
 }
 
+void FAT32Directory::rewind() {
+    f_readdir(dir, NULL);
+}
+
 void FAT32Directory::close() {
     delete dir;
 }
@@ -4,6 +4,7 @@
 #include <fs/FS.h>
 #include <fs/File.h>
 #include <fs/Directory.h>
+#include <core/Mutex.h>
 #include <libfat/ff.h>
 
 
@@ -15,6 +16,17 @@ public:
     virtual Directory* opendir(char* path);
     virtual void rename(char* opath, char* npath);
     virtual void unlink(char* path);
+    virtual void mkdir(char* path, int mode);
+    virtual void rmdir(char* path);
+    virtual int stat(char* path, struct stat* stat);
+    virtual bool cacheDentries();
+    virtual bool caseInsensitive();
+
+    // Bounce buffer for multi-page reads and writeback, shared by
+    // every file on the volume. It stays locked across the FatFs call
+    // and the copy after it, since FatFs drops its own lock in between
+    uint8_t* staging;
+    Mutex stagingLock;
 private:
     FATFS* fs;
 };  
@@ -22,24 +34,42 @@ private:
 
 class FAT32File : public StreamFile {
 public:
-    FAT32File(const char*, FAT32FS*, FIL* f);
-    ~FAT32File();
+    FAT32File(FAT32FS*, VNode*, FIL* f);
     virtual int write(const void* buffer, uint64_t count);
     virtual uint64_t read(void* buffer, uint64_t count);
     virtual void close();
     virtual bool canRead();
     virtual int stat(struct stat* stat);
     virtual uint64_t seek(uint64_t offset, uint64_t whence);
+    virtual int64_t readv(const struct iovec* iov, int count);
+    virtual int64_t writev(const struct iovec* iov, int count);
+    virtual int64_t preadv(const struct iovec* iov, int count, uint64_t offset);
+    virtual int64_t pwritev(const struct iovec* iov, int count, uint64_t offset);
     virtual bool isEOF();
+    virtual int sync();
 private:
+    int64_t transfer(const struct iovec* iov, int count, uint64_t offset, bool write);
+    uint64_t cachedRead(void* buffer, uint64_t count, uint64_t offset);
+    uint64_t cachedWrite(const void* buffer, uint64_t count, uint64_t offset);
+    uint8_t* fill(uint64_t index, uint64_t count);
+    bool writeback();
+    void seekTo(uint64_t offset);
+    void buildLinkMap();
+    void dropLinkMap();
     bool eof;
     FIL* fil;
+    uint64_t position;
+    uint64_t nextRead;
+    uint64_t readahead;
+    DWORD* linkMap;
+    uint64_t linkMapSize;
 };
 
 class FAT32Directory : public Directory {
 public:
-    FAT32Directory(const char* path, FAT32FS* f, FDIR*);
+    FAT32Directory(FAT32FS* f, FDIR*);
     virtual struct dirent* read();
+    virtual void rewind();
     virtual void close();
     virtual int stat(struct stat* stat);
 private:
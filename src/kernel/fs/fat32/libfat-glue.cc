@@ -1,32 +1,47 @@
-#include <hardware/ata/ATA.h>
+#include <block/BlockDevice.h>
+#include <alloc/malloc.h>
+#include <core/Mutex.h>
 #include <libfat/diskio.h>
+#include <libfat/ff.h>
+#include <stddef.h>
+
+
+// The volume is the first partition of the first disk, or the whole
+// disk when it has no partition table. Disks register in probe order,
+// so NVMe comes first, then virtio-blk, AHCI and IDE
+static BlockDevice* volume = NULL;
 
 extern "C" {
     DSTATUS disk_initialize (BYTE pdrv) {
-        ata_init();
-        return 0;
+        BlockDevice* disk = BlockDevice::devices;
+        while (disk && (disk->parent || !disk->sectors))
+            disk = disk->next;
+        volume = disk;
+        for (BlockDevice* d = BlockDevice::devices; d; d = d->next)
+            if (d->parent == disk) {
+                volume = d;
+                break;
+            }
+        return volume ? 0 : STA_NOINIT;
     }
 
     DSTATUS disk_status (BYTE pdrv) {
-        return 0;
-
+        return volume ? 0 : STA_NOINIT;
     }
 
     DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, BYTE count) {
-        for (int i = 0; i < count; i++)
-            ata_read(sector + i, (uint8_t*)((uint64_t)buff + 512 * i));
-        return (DRESULT)0;
+        return volume->read(sector, count, buff) ? RES_ERROR : RES_OK;
     }
 
     DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, BYTE count) {
-        for (int i = 0; i < count; i++)
-            ata_write(sector + i, (uint8_t*)((uint64_t)buff + 512 * i));
-        return (DRESULT)0;
+        return volume->write(sector, count, buff) ? RES_ERROR : RES_OK;
     }
 
     DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff) {
         if (cmd == GET_SECTOR_SIZE)
             *(WORD*)buff = 512;
+        if (cmd == GET_SECTOR_COUNT)
+            *(DWORD*)buff = volume->sectors;
         return (DRESULT)0;
     }
 
@@ -41,4 +56,34 @@ extern "C" {
     WCHAR ff_wtoupper (WCHAR chr) {
         return chr;
     }
+
+    void* ff_memalloc (UINT msize) {
+        return kmalloc(msize);
+    }
+
+    void ff_memfree (void* mblock) {
+        kfree(mblock);
+    }
+
+    int ff_cre_syncobj (BYTE vol, _SYNC_t* sobj) {
+        *sobj = new Mutex();
+        return 1;
+    }
+
+    int ff_del_syncobj (_SYNC_t sobj) {
+        delete (Mutex*)sobj;
+        return 1;
+    }
+
+    // Disk I/O sleeps in BlockDevice::wait, so other threads run while
+    // a FatFs call is in progress and the volume lock does contend.
+    // Mutex::lock sleeps the same way and restores the paused state
+    int ff_req_grant (_SYNC_t sobj) {
+        ((Mutex*)sobj)->lock();
+        return 1;
+    }
+
+    void ff_rel_grant (_SYNC_t sobj) {
+        ((Mutex*)sobj)->unlock();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include <fs/procfs/DiskStatsFile.h>
+#include <block/BlockDevice.h>
+#include <alloc/malloc.h>
+#include <string.h>
+
+
+#define DISKSTATS_SIZE 4096
+
+
+DiskStatsFile::DiskStatsFile(FS* fs) : StreamFile(fs) {
+    content = NULL;
+    offset = 0;
+    size = 0;
+}
+
+uint64_t DiskStatsFile::read(void* buffer, uint64_t count) {
+    if (!content) {
+        content = (char*)kmalloc(DISKSTATS_SIZE);
+        size = BlockDevice::renderStats(content, DISKSTATS_SIZE);
+    }
+
+    uint64_t c = (size - offset < count) ? size - offset : count;
+    memcpy(buffer, content + offset, c);
+    offset += c;
+    return c;
+}
+
+void DiskStatsFile::close() {
+    if (content)
+        kfree(content);
+    content = NULL;
+}
+
+bool DiskStatsFile::canRead() {
+    return true;
+}
+
+bool DiskStatsFile::isEOF() {
+    return content && offset == size;
+}
+
+int DiskStatsFile::stat(struct stat* stat) {
+    File::stat(stat);
+    stat->st_mode |= S_IFREG;
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef FS_PROCFS_DISKSTATSFILE_H
+#define FS_PROCFS_DISKSTATSFILE_H
+
+#include <fs/File.h>
+#include <fs/FS.h>
+
+
+class DiskStatsFile : public StreamFile {
+public:
+    DiskStatsFile(FS*);
+    virtual uint64_t read(void* buffer, uint64_t count);
+    virtual void close();
+    virtual bool canRead();
+    virtual bool isEOF();
+    virtual int stat(struct stat* stat);
+private:
+    char* content;
+    uint64_t offset, size;
+};
+
+#endif
@@ -1,10 +1,13 @@
 #include <core/Scheduler.h>
 #include <core/Process.h>
 #include <fs/procfs/ProcFS.h>
+#include <fs/procfs/DiskStatsFile.h>
+#include <fs/procfs/TraceFile.h>
 #include <fs/vfs/VFS.h>
 #include <fs/File.h>
 #include <string.h>
 #include <kutil.h>
+#include <errno.h>
 
 
 static char* CONTENT_OSRELEASE = "1.0\n";
@@ -20,6 +23,12 @@ StreamFile* ProcFS::open(char* path, int flags) {
     if (strcmp(path, "/sys/kernel/osrelease") == 0) {
         return new StaticFile(CONTENT_OSRELEASE, strlen(CONTENT_OSRELEASE));
     }
+    if (strcmp(path, "/trace") == 0) {
+        return new TraceFile(this);
+    }
+    if (strcmp(path, "/diskstats") == 0) {
+        return new DiskStatsFile(this);
+    }
     if (strcmp(path, "/self/exe") == 0) {
         return VFS::get()->open(Scheduler::get()->getActiveThread()->process->exeName, flags);
     }
@@ -30,3 +39,38 @@ StreamFile* ProcFS::open(char* path, int flags) {
 Directory* ProcFS::opendir(char* path) {
     return NULL;
 }
+
+static const char* directories[] = {
+    "", "/", "/self", "/sys", "/sys/kernel", NULL
+};
+
+int ProcFS::stat(char* path, struct stat* stat) {
+    if (strcmp(path, "/self/exe") == 0)
+        return VFS::get()->stat(Scheduler::get()->getActiveThread()->process->exeName, stat);
+    return lstat(path, stat);
+}
+
+int ProcFS::lstat(char* path, struct stat* stat) {
+    stat_init(stat);
+    for (int i = 0; directories[i]; i++)
+        if (strcmp(path, directories[i]) == 0) {
+            stat->st_mode |= S_IFDIR;
+            return 0;
+        }
+    if (strcmp(path, "/sys/kernel/osrelease") == 0) {
+        stat->st_mode |= S_IFREG;
+        stat->st_size = strlen(CONTENT_OSRELEASE);
+        return 0;
+    }
+    if (strcmp(path, "/trace") == 0 || strcmp(path, "/diskstats") == 0) {
+        stat->st_mode |= S_IFREG;
+        return 0;
+    }
+    if (strcmp(path, "/self/exe") == 0) {
+        stat->st_mode |= S_IFLNK;
+        stat->st_size = strlen(Scheduler::get()->getActiveThread()->process->exeName);
+        return 0;
+    }
+    seterr(ENOENT);
+    return -1;
+}
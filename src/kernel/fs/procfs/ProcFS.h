@@ -12,6 +12,8 @@ public:
     virtual char* getName();
     virtual StreamFile* open(char* path, int flags);
     virtual Directory* opendir(char* path);
+    virtual int stat(char* path, struct stat* stat);
+    virtual int lstat(char* path, struct stat* stat);
 };  
 
 
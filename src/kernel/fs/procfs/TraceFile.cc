@@ -0,0 +1,67 @@
+#include <fs/procfs/TraceFile.h>
+#include <core/Trace.h>
+#include <alloc/malloc.h>
+#include <errno.h>
+#include <string.h>
+#include <kutil.h>
+
+
+#define TRACE_LINE_SIZE 256
+
+
+TraceFile::TraceFile(FS* fs) : StreamFile(fs) {
+    content = NULL;
+    offset = 0;
+    size = 0;
+}
+
+int TraceFile::write(const void* buffer, uint64_t count) {
+    // "1" turns tracing on, "0" turns it off, "c" drops recorded entries
+    for (uint64_t i = 0; i < count; i++) {
+        char c = ((const char*)buffer)[i];
+        if (c == '1')
+            Trace::enabled = true;
+        if (c == '0')
+            Trace::enabled = false;
+        if (c == 'c')
+            Trace::clear();
+    }
+    return count;
+}
+
+uint64_t TraceFile::read(void* buffer, uint64_t count) {
+    if (!content) {
+        uint64_t capacity = KCFG_MAX_CPUS * KCFG_TRACE_RING_SIZE * TRACE_LINE_SIZE;
+        content = (char*)kmalloc(capacity);
+        if (!content) {
+            seterr(ENOMEM);
+            return (uint64_t)-1;
+        }
+        size = Trace::render(content, capacity);
+    }
+
+    uint64_t c = (size - offset < count) ? size - offset : count;
+    memcpy(buffer, content + offset, c);
+    offset += c;
+    return c;
+}
+
+void TraceFile::close() {
+    if (content)
+        kfree(content);
+    content = NULL;
+}
+
+bool TraceFile::canRead() {
+    return true;
+}
+
+bool TraceFile::isEOF() {
+    return content && offset == size;
+}
+
+int TraceFile::stat(struct stat* stat) {
+    File::stat(stat);
+    stat->st_mode |= S_IFREG;
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef FS_PROCFS_TRACEFILE_H
+#define FS_PROCFS_TRACEFILE_H
+
+#include <fs/File.h>
+#include <fs/FS.h>
+
+
+class TraceFile : public StreamFile {
+public:
+    TraceFile(FS*);
+    virtual int write(const void* buffer, uint64_t count);
+    virtual uint64_t read(void* buffer, uint64_t count);
+    virtual void close();
+    virtual bool canRead();
+    virtual bool isEOF();
+    virtual int stat(struct stat* stat);
+private:
+    char* content;
+    uint64_t offset, size;
+};
+
+#endif
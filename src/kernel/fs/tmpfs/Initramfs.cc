@@ -0,0 +1,97 @@
+#include <fs/tmpfs/Initramfs.h>
+#include <kutil.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+
+#define CPIO_HEADER_SIZE 110
+#define CPIO_ALIGN(x) (((x) + 3) & ~3ULL)
+
+
+static uint64_t cpio_field(uint8_t* header, int index) {
+    uint64_t value = 0;
+    uint8_t* p = header + 6 + index * 8;
+    for (int i = 0; i < 8; i++) {
+        uint8_t c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+    }
+    return value;
+}
+
+
+bool Initramfs::load(TmpFS* fs, uint8_t* data, uint64_t size) {
+    if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        klog('e', "initramfs is gzip-compressed; only uncompressed cpio is supported");
+        return false;
+    }
+
+    uint64_t offset = 0;
+    int files = 0;
+
+    while (offset + CPIO_HEADER_SIZE <= size) {
+        uint8_t* header = data + offset;
+        if (memcmp(header, "070701", 6) && memcmp(header, "070702", 6)) {
+            klog('e', "initramfs: bad cpio magic at offset %lx", offset);
+            return false;
+        }
+
+        uint64_t mode = cpio_field(header, 1);
+        uint64_t fileSize = cpio_field(header, 6);
+        uint64_t nameSize = cpio_field(header, 11);
+        char* name = (char*)(header + CPIO_HEADER_SIZE);
+        uint64_t dataOffset = CPIO_ALIGN(offset + CPIO_HEADER_SIZE + nameSize);
+
+        if (dataOffset + fileSize > size || nameSize == 0) {
+            klog('e', "initramfs: truncated archive");
+            return false;
+        }
+
+        // The name and the leading '/' added below must fit in path
+        char path[1024];
+        if (nameSize >= sizeof(path) || name[nameSize - 1]) {
+            klog('e', "initramfs: bad file name at offset %lx", offset);
+            return false;
+        }
+        if (!strcmp(name, "TRAILER!!!"))
+            break;
+
+        char* end = name + nameSize - 1;
+        while (*name == '.' && name[1] == '/')
+            name += 2;
+        while (*name == '/')
+            name++;
+        path[0] = '/';
+        memcpy(path + 1, name, end - name + 1);
+
+        geterr();
+        if (!strcmp(path, "/") || !strcmp(path, "/.")) {
+            // archive root
+        } else if (S_ISDIR(mode)) {
+            fs->mkdir(path, mode & 07777);
+            if (haserr() && geterr() != EEXIST)
+                klog('w', "initramfs: cannot create %s", path);
+        } else if (S_ISREG(mode)) {
+            StreamFile* f = fs->open(path, O_CREAT | O_WRONLY | O_TRUNC);
+            if (f) {
+                f->write(data + dataOffset, fileSize);
+                f->close();
+                delete f;
+                files++;
+            } else
+                klog('w', "initramfs: cannot create %s", path);
+        } else
+            klog('w', "initramfs: skipping %s (mode %lo)", path, mode);
+
+        offset = CPIO_ALIGN(dataOffset + fileSize);
+    }
+
+    klog('i', "initramfs: unpacked %i files", files);
+    return true;
+}
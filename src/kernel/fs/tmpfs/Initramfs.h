@@ -0,0 +1,15 @@
+#ifndef FS_TMPFS_INITRAMFS_H
+#define FS_TMPFS_INITRAMFS_H
+
+#include <lang/lang.h>
+#include <fs/tmpfs/TmpFS.h>
+
+
+class Initramfs {
+public:
+    // Unpacks a newc cpio archive into the filesystem
+    static bool load(TmpFS* fs, uint8_t* data, uint64_t size);
+};
+
+
+#endif
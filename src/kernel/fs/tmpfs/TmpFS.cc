@@ -0,0 +1,473 @@
+#include <fs/tmpfs/TmpFS.h>
+#include <alloc/malloc.h>
+#include <kconfig.h>
+#include <kutil.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+
+TmpFS::TmpFS() {
+    root = new tmpfs_node_t();
+    memset(root, 0, sizeof(tmpfs_node_t));
+    root->directory = true;
+    root->vnode = new VNode(this, (uint64_t)root, S_IFDIR);
+    root->vnode->acquire(); // never released
+    pagesUsed = 0;
+}
+
+char* TmpFS::getName() {
+    return "tmpfs";
+}
+
+tmpfs_node_t* TmpFS::resolve(char* path, tmpfs_node_t** parent, char* leaf) {
+    tmpfs_node_t* node = root;
+    tmpfs_node_t* last = NULL;
+    char name[256];
+    name[0] = 0;
+
+    while (*path) {
+        while (*path == '/')
+            path++;
+        if (!*path)
+            break;
+
+        int len = 0;
+        while (path[len] && path[len] != '/')
+            len++;
+        if (len > 255) {
+            seterr(ENAMETOOLONG);
+            return NULL;
+        }
+
+        if (!node) {
+            // A non-final component is missing
+            seterr(ENOENT);
+            return NULL;
+        }
+        if (!node->directory) {
+            seterr(ENOTDIR);
+            return NULL;
+        }
+
+        memcpy(name, path, len);
+        name[len] = 0;
+        path += len;
+
+        last = node;
+        tmpfs_node_t* child = node->children;
+        while (child && strcmp(child->name, name))
+            child = child->next;
+        node = child;
+    }
+
+    if (parent)
+        *parent = last;
+    if (leaf)
+        strcpy(leaf, name);
+    return node;
+}
+
+tmpfs_node_t* TmpFS::create(tmpfs_node_t* parent, char* name, bool directory) {
+    tmpfs_node_t* node = new tmpfs_node_t();
+    memset(node, 0, sizeof(tmpfs_node_t));
+    strcpy(node->name, name);
+    node->directory = directory;
+    node->parent = parent;
+    node->next = parent->children;
+    parent->children = node;
+
+    // The directory entry holds a reference; the node and its pages
+    // go away once it is unlinked and the last open file is closed
+    node->vnode = new VNode(this, (uint64_t)node, directory ? S_IFDIR : S_IFREG);
+    node->vnode->acquire();
+    return node;
+}
+
+void TmpFS::detach(tmpfs_node_t* node) {
+    tmpfs_node_t** p = &node->parent->children;
+    while (*p != node)
+        p = &(*p)->next;
+    *p = node->next;
+    node->next = NULL;
+    node->parent = NULL;
+}
+
+bool TmpFS::chargePage() {
+    if (pagesUsed >= KCFG_TMPFS_MAX_PAGES)
+        return false;
+    pagesUsed++;
+    return true;
+}
+
+void TmpFS::unchargePage() {
+    pagesUsed--;
+}
+
+void TmpFS::releaseVNode(VNode* vnode) {
+    delete (tmpfs_node_t*)vnode->id;
+    delete vnode;
+}
+
+StreamFile* TmpFS::open(char* path, int flags) {
+    tmpfs_node_t* parent;
+    char leaf[256];
+    geterr();
+    tmpfs_node_t* node = resolve(path, &parent, leaf);
+    if (haserr())
+        return NULL;
+
+    if (node && (flags & O_CREAT) && (flags & O_EXCL)) {
+        seterr(EEXIST);
+        return NULL;
+    }
+    if (!node) {
+        if (!(flags & O_CREAT) || !parent) {
+            seterr(ENOENT);
+            return NULL;
+        }
+        node = create(parent, leaf, false);
+    }
+    if (node->directory) {
+        seterr(EISDIR);
+        return NULL;
+    }
+
+    if ((flags & O_TRUNC) && (flags & (O_WRONLY | O_RDWR)))
+        node->vnode->truncate(0);
+
+    StreamFile* f = new TmpFSFile(this, node->vnode);
+    f->flags = flags;
+    if (flags & O_APPEND)
+        f->seek(0, SEEK_END);
+    return f;
+}
+
+Directory* TmpFS::opendir(char* path) {
+    geterr();
+    tmpfs_node_t* node = resolve(path, NULL, NULL);
+    if (haserr())
+        return NULL;
+    if (!node) {
+        seterr(ENOENT);
+        return NULL;
+    }
+    if (!node->directory) {
+        seterr(ENOTDIR);
+        return NULL;
+    }
+    return new TmpFSDirectory(this, node);
+}
+
+void TmpFS::rename(char* opath, char* npath) {
+    tmpfs_node_t* nparent;
+    char leaf[256];
+
+    tmpfs_node_t* node = resolve(opath, NULL, NULL);
+    if (haserr())
+        return;
+    if (!node || node == root) {
+        seterr(node ? EBUSY : ENOENT);
+        return;
+    }
+
+    tmpfs_node_t* target = resolve(npath, &nparent, leaf);
+    if (haserr())
+        return;
+    if (!nparent) {
+        seterr(ENOENT);
+        return;
+    }
+    if (target == node)
+        return;
+    for (tmpfs_node_t* p = nparent; p; p = p->parent)
+        if (p == node) {
+            seterr(EINVAL);
+            return;
+        }
+
+    if (target) {
+        if (target->directory != node->directory) {
+            seterr(target->directory ? EISDIR : ENOTDIR);
+            return;
+        }
+        if (target->directory && target->children) {
+            seterr(ENOTEMPTY);
+            return;
+        }
+        detach(target);
+        target->vnode->release();
+    }
+
+    detach(node);
+    strcpy(node->name, leaf);
+    node->parent = nparent;
+    node->next = nparent->children;
+    nparent->children = node;
+}
+
+void TmpFS::unlink(char* path) {
+    tmpfs_node_t* node = resolve(path, NULL, NULL);
+    if (haserr())
+        return;
+    if (!node) {
+        seterr(ENOENT);
+        return;
+    }
+    if (node->directory) {
+        seterr(EISDIR);
+        return;
+    }
+
+    detach(node);
+    node->vnode->release();
+}
+
+void TmpFS::rmdir(char* path) {
+    tmpfs_node_t* node = resolve(path, NULL, NULL);
+    if (haserr())
+        return;
+    if (!node) {
+        seterr(ENOENT);
+        return;
+    }
+    if (!node->directory) {
+        seterr(ENOTDIR);
+        return;
+    }
+    if (node == root) {
+        seterr(EBUSY);
+        return;
+    }
+    if (node->children) {
+        seterr(ENOTEMPTY);
+        return;
+    }
+
+    detach(node);
+    node->vnode->release();
+}
+
+int TmpFS::stat(char* path, struct stat* stat) {
+    geterr();
+    tmpfs_node_t* node = resolve(path, NULL, NULL);
+    if (haserr())
+        return -1;
+    if (!node) {
+        seterr(ENOENT);
+        return -1;
+    }
+
+    stat_init(stat);
+    stat->st_ino = node->vnode->id;
+    if (node->directory)
+        stat->st_mode |= S_IFDIR;
+    else {
+        stat->st_mode |= S_IFREG;
+        stat->st_size = node->vnode->size;
+        stat->st_blksize = KCFG_PAGE_SIZE;
+        stat->st_blocks = (node->vnode->size + 511) / 512;
+    }
+    return 0;
+}
+
+bool TmpFS::cacheDentries() {
+    return true;
+}
+
+void TmpFS::mkdir(char* path, int mode) {
+    tmpfs_node_t* parent;
+    char leaf[256];
+    tmpfs_node_t* node = resolve(path, &parent, leaf);
+    if (haserr())
+        return;
+    if (node) {
+        seterr(EEXIST);
+        return;
+    }
+    if (!parent) {
+        seterr(ENOENT);
+        return;
+    }
+    create(parent, leaf, true);
+}
+
+
+
+TmpFSFile::TmpFSFile(TmpFS* fs, VNode* v) : StreamFile(fs, v) {
+    position = 0;
+}
+
+uint64_t TmpFSFile::transfer(void* buffer, uint64_t count, uint64_t offset, bool write) {
+    // The vnode's page cache is the only copy of the data
+    if (!write) {
+        if (offset >= vnode->size)
+            return 0;
+        if (count > vnode->size - offset)
+            count = vnode->size - offset;
+    }
+
+    uint64_t done = 0;
+    while (done < count) {
+        uint64_t index = (offset + done) / KCFG_PAGE_SIZE;
+        uint64_t pageOffset = (offset + done) % KCFG_PAGE_SIZE;
+        uint64_t c = KCFG_PAGE_SIZE - pageOffset;
+        if (c > count - done)
+            c = count - done;
+
+        uint8_t* page = vnode->getPage(index);
+        if (write) {
+            if (!page)
+                page = vnode->addPage(index);
+            if (!page)
+                break; // out of budget
+            memcpy(page + pageOffset, (uint8_t*)buffer + done, c);
+        } else if (page)
+            memcpy((uint8_t*)buffer + done, page + pageOffset, c);
+        else
+            memset((uint8_t*)buffer + done, 0, c); // hole
+        done += c;
+    }
+
+    if (write && offset + done > vnode->size)
+        vnode->size = offset + done;
+    return done;
+}
+
+int TmpFSFile::write(const void* buffer, uint64_t count) {
+    if (flags & O_APPEND)
+        position = vnode->size;
+    uint64_t c = transfer((void*)buffer, count, position, true);
+    if (!c && count) {
+        seterr(ENOSPC);
+        return -1;
+    }
+    position += c;
+    return c;
+}
+
+uint64_t TmpFSFile::read(void* buffer, uint64_t count) {
+    uint64_t c = transfer(buffer, count, position, false);
+    position += c;
+    return c;
+}
+
+int64_t TmpFSFile::preadv(const struct iovec* iov, int count, uint64_t offset) {
+    int64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t c = transfer(iov[i].iov_base, iov[i].iov_len, offset + total, false);
+        total += c;
+        if (c < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
+int64_t TmpFSFile::pwritev(const struct iovec* iov, int count, uint64_t offset) {
+    int64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t c = transfer(iov[i].iov_base, iov[i].iov_len, offset + total, true);
+        total += c;
+        if (c < iov[i].iov_len) {
+            if (!total) {
+                seterr(ENOSPC);
+                return -1;
+            }
+            break;
+        }
+    }
+    return total;
+}
+
+uint64_t TmpFSFile::seek(uint64_t offset, uint64_t whence) {
+    if (whence == SEEK_SET)
+        position = offset;
+    else if (whence == SEEK_CUR)
+        position += offset;
+    else if (whence == SEEK_END)
+        position = vnode->size + offset;
+    else
+        return (uint64_t)-1;
+    return position;
+}
+
+bool TmpFSFile::canRead() {
+    return true;
+}
+
+bool TmpFSFile::isEOF() {
+    return position >= vnode->size;
+}
+
+int TmpFSFile::stat(struct stat* stat) {
+    File::stat(stat);
+    stat->st_ino = vnode->id;
+    stat->st_size = vnode->size;
+    stat->st_blksize = KCFG_PAGE_SIZE;
+    stat->st_blocks = (vnode->size + 511) / 512;
+    stat->st_mode |= S_IFREG;
+    return 0;
+}
+
+
+
+TmpFSDirectory::TmpFSDirectory(TmpFS* fs, tmpfs_node_t* n) : Directory(fs, n->vnode) {
+    node = n;
+    cursor = NULL;
+    position = 0;
+    started = false;
+}
+
+void TmpFSDirectory::moveTo(tmpfs_node_t* n) {
+    // The cursor holds a reference so an unlink can't free it between reads
+    if (n)
+        n->vnode->acquire();
+    if (cursor)
+        cursor->vnode->release();
+    cursor = n;
+}
+
+struct dirent* TmpFSDirectory::read() {
+    tmpfs_node_t* next;
+    if (!started)
+        next = node->children;
+    else if (!cursor)
+        next = NULL;
+    else if (cursor->parent == node)
+        next = cursor->next;
+    else {
+        // The last entry was unlinked or moved out, so pick up at the
+        // same position instead
+        next = node->children;
+        for (uint64_t i = 1; next && i < position; i++)
+            next = next->next;
+    }
+    started = true;
+    moveTo(next);
+    if (!cursor)
+        return NULL;
+    position++;
+
+    strcpy(currentEntry.d_name, cursor->name);
+    currentEntry.d_ino = (uint64_t)cursor;
+    currentEntry.d_type = cursor->directory ? DT_DIR : DT_REG;
+    return &currentEntry;
+}
+
+void TmpFSDirectory::rewind() {
+    moveTo(NULL);
+    position = 0;
+    started = false;
+}
+
+void TmpFSDirectory::close() {
+    moveTo(NULL);
+    File::close();
+}
+
+int TmpFSDirectory::stat(struct stat* stat) {
+    Directory::stat(stat);
+    stat->st_ino = vnode->id;
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef FS_TMPFS_TMPFS_H
+#define FS_TMPFS_TMPFS_H
+
+#include <fs/FS.h>
+#include <fs/File.h>
+#include <fs/Directory.h>
+
+
+struct tmpfs_node_t {
+    char name[256];
+    bool directory;
+    tmpfs_node_t* parent;
+    tmpfs_node_t* children;
+    tmpfs_node_t* next;
+    VNode* vnode;
+};
+
+
+class TmpFS : public FS {
+public:
+    TmpFS();
+    virtual char* getName();
+    virtual StreamFile* open(char* path, int flags);
+    virtual Directory* opendir(char* path);
+    virtual void rename(char* opath, char* npath);
+    virtual void unlink(char* path);
+    virtual void mkdir(char* path, int mode);
+    virtual void rmdir(char* path);
+    virtual int stat(char* path, struct stat* stat);
+    virtual bool cacheDentries();
+    virtual void releaseVNode(VNode* vnode);
+    virtual bool chargePage();
+    virtual void unchargePage();
+private:
+    tmpfs_node_t* resolve(char* path, tmpfs_node_t** parent, char* leaf);
+    tmpfs_node_t* create(tmpfs_node_t* parent, char* name, bool directory);
+    void detach(tmpfs_node_t* node);
+
+    tmpfs_node_t* root;
+    // File data lives on the kernel heap, so it gets a fixed budget
+    uint64_t pagesUsed;
+};
+
+
+class TmpFSFile : public StreamFile {
+public:
+    TmpFSFile(TmpFS* fs, VNode* vnode);
+    virtual int write(const void* buffer, uint64_t count);
+    virtual uint64_t read(void* buffer, uint64_t count);
+    virtual uint64_t seek(uint64_t offset, uint64_t whence);
+    virtual int64_t preadv(const struct iovec* iov, int count, uint64_t offset);
+    virtual int64_t pwritev(const struct iovec* iov, int count, uint64_t offset);
+    virtual bool canRead();
+    virtual bool isEOF();
+    virtual int stat(struct stat* stat);
+private:
+    uint64_t transfer(void* buffer, uint64_t count, uint64_t offset, bool write);
+    uint64_t position;
+};
+
+
+class TmpFSDirectory : public Directory {
+public:
+    TmpFSDirectory(TmpFS* fs, tmpfs_node_t* node);
+    virtual struct dirent* read();
+    virtual void rewind();
+    virtual void close();
+    virtual int stat(struct stat* stat);
+private:
+    void moveTo(tmpfs_node_t* n);
+
+    tmpfs_node_t* node;
+    tmpfs_node_t* cursor;
+    uint64_t position;
+    bool started;
+};
+
+
+#endif
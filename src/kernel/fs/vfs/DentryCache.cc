@@ -0,0 +1,148 @@
+#include <fs/vfs/DentryCache.h>
+#include <string.h>
+
+
+static uint8_t dentry_fold(char c, bool fold) {
+    if (fold && c >= 'a' && c <= 'z')
+        return c - 'a' + 'A';
+    return c;
+}
+
+static uint32_t dentry_hash(uint64_t parent, const char* name, int len, bool fold) {
+    uint32_t h = 2166136261u ^ (uint32_t)parent ^ (uint32_t)(parent >> 32);
+    for (int i = 0; i < len; i++) {
+        h ^= dentry_fold(name[i], fold);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool dentry_match(const char* a, const char* b, int len, bool fold) {
+    for (int i = 0; i < len; i++)
+        if (dentry_fold(a[i], fold) != dentry_fold(b[i], fold))
+            return false;
+    return !a[len];
+}
+
+static const char* next_component(const char* p, int* len) {
+    while (*p == '/')
+        p++;
+    *len = 0;
+    while (p[*len] && p[*len] != '/')
+        (*len)++;
+    return p;
+}
+
+
+DentryCache::DentryCache() {
+    flush();
+}
+
+void DentryCache::flush() {
+    memset(entries, 0, sizeof(entries));
+    for (int i = 0; i < KCFG_DENTRY_HASH_SIZE; i++)
+        buckets[i] = -1;
+    nextId = 1; // 0 is the root
+    hand = 0;
+}
+
+int DentryCache::find(uint64_t parent, uint32_t hash, const char* name, int len, bool fold) {
+    for (int i = buckets[hash % KCFG_DENTRY_HASH_SIZE]; i >= 0; i = entries[i].next) {
+        dentry_t* d = &entries[i];
+        if (d->hash == hash && d->parent == parent && dentry_match(d->name, name, len, fold))
+            return i;
+    }
+    return -1;
+}
+
+void DentryCache::unhash(int index) {
+    int* p = &buckets[entries[index].hash % KCFG_DENTRY_HASH_SIZE];
+    while (*p != index)
+        p = &entries[*p].next;
+    *p = entries[index].next;
+    entries[index].id = 0;
+}
+
+int DentryCache::allocate() {
+    // Clock eviction. Children of an evicted entry become unreachable
+    // because they are keyed by its id, and age out in turn
+    while (true) {
+        int i = hand;
+        hand = (hand + 1) % KCFG_DENTRY_CACHE_SIZE;
+        if (!entries[i].id)
+            return i;
+        if (entries[i].referenced) {
+            entries[i].referenced = false;
+            continue;
+        }
+        unhash(i);
+        return i;
+    }
+}
+
+int DentryCache::lookup(const char* path, bool fold) {
+    uint64_t parent = 0;
+    int type = DENTRY_DIRECTORY;
+    int len;
+
+    for (const char* p = next_component(path, &len); len; p = next_component(p + len, &len)) {
+        int i = find(parent, dentry_hash(parent, p, len, fold), p, len, fold);
+        if (i < 0) {
+            misses++;
+            return DENTRY_UNKNOWN;
+        }
+        entries[i].referenced = true;
+        type = entries[i].type;
+        if (type == DENTRY_NEGATIVE)
+            break;
+        parent = entries[i].id;
+    }
+
+    if (type == DENTRY_UNKNOWN)
+        misses++;
+    else
+        hits++;
+    return type;
+}
+
+void DentryCache::set(const char* path, int type, bool fold) {
+    uint64_t parent = 0;
+    int len;
+
+    for (const char* p = next_component(path, &len); len; ) {
+        int nextLen;
+        const char* next = next_component(p + len, &nextLen);
+        bool last = !nextLen;
+
+        uint32_t hash = dentry_hash(parent, p, len, fold);
+        int i = find(parent, hash, p, len, fold);
+        if (i < 0) {
+            if (len >= KCFG_DENTRY_NAME_SIZE)
+                return;
+            i = allocate();
+            dentry_t* d = &entries[i];
+            memcpy(d->name, p, len);
+            d->name[len] = 0;
+            d->hash = hash;
+            d->parent = parent;
+            d->id = nextId++;
+            d->type = DENTRY_UNKNOWN;
+            d->next = buckets[hash % KCFG_DENTRY_HASH_SIZE];
+            buckets[hash % KCFG_DENTRY_HASH_SIZE] = i;
+        }
+
+        dentry_t* d = &entries[i];
+        d->referenced = true;
+        if (last) {
+            // A vanished entry must not resurrect its old children
+            if (type == DENTRY_NEGATIVE && d->type != DENTRY_NEGATIVE)
+                d->id = nextId++;
+            d->type = type;
+        } else if (type != DENTRY_NEGATIVE)
+            d->type = DENTRY_DIRECTORY;
+
+        parent = d->id;
+        p = next;
+        len = nextLen;
+    }
+}
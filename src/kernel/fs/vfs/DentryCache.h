@@ -0,0 +1,48 @@
+#ifndef FS_VFS_DENTRYCACHE_H
+#define FS_VFS_DENTRYCACHE_H
+
+#include <lang/lang.h>
+#include <lang/Singleton.h>
+#include <kconfig.h>
+
+
+#define DENTRY_UNKNOWN 0
+#define DENTRY_NEGATIVE 1
+#define DENTRY_FILE 2
+#define DENTRY_DIRECTORY 3
+
+
+struct dentry_t {
+    uint64_t id, parent;
+    uint32_t hash;
+    int type;
+    int next;
+    bool referenced;
+    char name[KCFG_DENTRY_NAME_SIZE];
+};
+
+
+// Caches what path resolution learned about absolute VFS paths, keyed by
+// (parent, name). Negative entries remember paths that do not exist.
+// With fold set, names are matched ignoring ASCII case
+class DentryCache : public Singleton<DentryCache> {
+public:
+    DentryCache();
+    int lookup(const char* path, bool fold);
+    void set(const char* path, int type, bool fold);
+    void flush();
+
+    uint64_t hits, misses;
+private:
+    int find(uint64_t parent, uint32_t hash, const char* name, int len, bool fold);
+    int allocate();
+    void unhash(int index);
+
+    dentry_t entries[KCFG_DENTRY_CACHE_SIZE];
+    int buckets[KCFG_DENTRY_HASH_SIZE];
+    uint64_t nextId;
+    int hand;
+};
+
+
+#endif
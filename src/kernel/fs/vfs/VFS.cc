@@ -1,33 +1,84 @@
 #include <fs/vfs/VFS.h>
+#include <fs/vfs/DentryCache.h>
 #include <string.h>
 #include <kutil.h>
 #include <errno.h>
+#include <fcntl.h>
 
 
+VFS::VFS() {
+    mounts = new mount_node_t();
+    memset(mounts, 0, sizeof(mount_node_t));
+}
+
+// Splits off the next component of a path, skipping leading slashes
+static char* vfs_component(char* path, int* length) {
+    while (*path == '/')
+        path++;
+    *length = 0;
+    while (path[*length] && path[*length] != '/')
+        (*length)++;
+    return path;
+}
+
+static mount_node_t* vfs_child(mount_node_t* node, char* name, int length) {
+    for (mount_node_t* c = node->children; c; c = c->next)
+        if (!strncmp(c->name, name, length) && !c->name[length])
+            return c;
+    return NULL;
+}
+
 void VFS::mount(char* point, FS* fs) {
-    auto m = new mount_t();
-    strcpy(m->path, point);
-    m->fs = fs;
+    mount_node_t* node = mounts;
+    char* p = point;
+    int length;
+    while (*(p = vfs_component(p, &length))) {
+        if (length > 255) {
+            seterr(ENAMETOOLONG);
+            return;
+        }
+        mount_node_t* child = vfs_child(node, p, length);
+        if (!child) {
+            child = new mount_node_t();
+            memset(child, 0, sizeof(mount_node_t));
+            memcpy(child->name, p, length);
+            child->next = node->children;
+            node->children = child;
+        }
+        node = child;
+        p += length;
+    }
+
     klog('i', " -- mounting %s at %s", fs->getName(), point);
-    mounts.add(m);
+    node->fs = fs;
+    DentryCache::get()->flush();
 }
 
 vfs_lookup_t VFS::lookup(char* path) {
+    // Walks the mount trie one component at a time; the deepest mount
+    // passed on the way wins
     vfs_lookup_t result;
-    result.found = false;
-
-    for (mount_t* m : mounts) {
-        if (strstr(path, m->path) == path) {
+    result.found = mounts->fs != NULL;
+    result.fs = mounts->fs;
+    result.path = path;
+
+    mount_node_t* node = mounts;
+    char* p = path;
+    int length;
+    while (*(p = vfs_component(p, &length))) {
+        node = vfs_child(node, p, length);
+        if (!node)
+            break;
+        p += length;
+        if (node->fs) {
             result.found = true;
-            result.fs = m->fs;
-            uint64_t offset = strlen(m->path);
-            if (offset == 1) offset = 0; // fix root
-            strcpy(result.path, (char*)((uint64_t)path + offset));
+            result.fs = node->fs;
+            result.path = p;
         }
     }
 
     if (!result.found) {
-        klog('w', "%s not found", path);klog_flush();
+        klog('w', "%s not found", path);
     }
 
     return result;
@@ -47,14 +98,91 @@ vfs_lookup_t VFS::lookup(char* path) {
     VFS_LOOKUP(lk, path, )
 
 
+static void vfs_set(FS* fs, char* path, int type) {
+    if (fs->cacheDentries())
+        DentryCache::get()->set(path, type, fs->caseInsensitive());
+}
+
+// Records the outcome of a lookup on a cacheable FS. Errors other than
+// ENOENT say nothing about existence and are left alone
+static void vfs_remember(FS* fs, char* path, bool found, int type) {
+    if (found)
+        vfs_set(fs, path, type);
+    else if (haserr()) {
+        int err = geterr();
+        if (err == ENOENT)
+            vfs_set(fs, path, DENTRY_NEGATIVE);
+        else if (err == EISDIR)
+            vfs_set(fs, path, DENTRY_DIRECTORY);
+        seterr(err);
+    }
+}
+
+static int vfs_cached(FS* fs, char* path) {
+    if (!fs->cacheDentries())
+        return DENTRY_UNKNOWN;
+    return DentryCache::get()->lookup(path, fs->caseInsensitive());
+}
+
+
 StreamFile* VFS::open(char* path, int flags) {
     VFS_LOOKUP_R(lk, path);
-    return lk.fs->open(lk.path, flags);
+
+    int cached = vfs_cached(lk.fs, path);
+    if (cached == DENTRY_NEGATIVE && !(flags & O_CREAT)) {
+        seterr(ENOENT);
+        return NULL;
+    }
+    if (cached == DENTRY_DIRECTORY) {
+        seterr(EISDIR);
+        return NULL;
+    }
+
+    auto f = lk.fs->open(lk.path, flags);
+    vfs_remember(lk.fs, path, f, DENTRY_FILE);
+    return f;
 }
 
 Directory* VFS::opendir(char* path) {
     VFS_LOOKUP_R(lk, path);
-    return lk.fs->opendir(lk.path);
+
+    int cached = vfs_cached(lk.fs, path);
+    if (cached == DENTRY_NEGATIVE) {
+        seterr(ENOENT);
+        return NULL;
+    }
+    if (cached == DENTRY_FILE) {
+        seterr(ENOTDIR);
+        return NULL;
+    }
+
+    auto d = lk.fs->opendir(lk.path);
+    vfs_remember(lk.fs, path, d, DENTRY_DIRECTORY);
+    return d;
+}
+
+int VFS::stat(char* path, struct stat* stat) {
+    return query(path, stat, false);
+}
+
+int VFS::lstat(char* path, struct stat* stat) {
+    return query(path, stat, true);
+}
+
+int VFS::query(char* path, struct stat* stat, bool link) {
+    VFS_LOOKUP(lk, path, -1);
+
+    if (vfs_cached(lk.fs, path) == DENTRY_NEGATIVE) {
+        seterr(ENOENT);
+        return -1;
+    }
+
+    int result = link ? lk.fs->lstat(lk.path, stat) : lk.fs->stat(lk.path, stat);
+    if (result == 0)
+        vfs_remember(lk.fs, path, true, S_ISDIR(stat->st_mode) ? DENTRY_DIRECTORY : DENTRY_FILE);
+    else
+        vfs_remember(lk.fs, path, false, DENTRY_UNKNOWN);
+    return result;
 }
 
 
@@ -67,10 +195,28 @@ void VFS::rename(char* opath, char* npath) {
         return;
     }
 
-    olk.fs->rename(opath, npath);
+    olk.fs->rename(olk.path, nlk.path);
+    // Renaming a directory moves a whole subtree
+    DentryCache::get()->flush();
 }
 
 void VFS::unlink(char* path) {
     VFS_LOOKUP_V(lk, path);
     lk.fs->unlink(lk.path);
+    if (!haserr())
+        vfs_set(lk.fs, path, DENTRY_NEGATIVE);
+}
+
+void VFS::rmdir(char* path) {
+    VFS_LOOKUP_V(lk, path);
+    lk.fs->rmdir(lk.path);
+    if (!haserr())
+        vfs_set(lk.fs, path, DENTRY_NEGATIVE);
+}
+
+void VFS::mkdir(char* path, int mode) {
+    VFS_LOOKUP_V(lk, path);
+    lk.fs->mkdir(lk.path, mode);
+    if (!haserr())
+        vfs_set(lk.fs, path, DENTRY_DIRECTORY);
 }
@@ -2,34 +2,42 @@
 #define FS_VFS_VFS_H
 
 #include <fs/FS.h>
-#include <lang/Pool.h>
 #include <lang/Singleton.h>
 #include <fs/File.h>
 #include <fs/Directory.h>
 
 
-struct mount_t {
-    char path[255];
+// One node per path component leading to a mount point
+struct mount_node_t {
+    char name[256];
     FS* fs;
+    mount_node_t* children;
+    mount_node_t* next;
 };
 
 struct vfs_lookup_t {
     bool found;
     FS* fs;
-    char path[255];
+    char* path; // remainder of the looked up path, relative to the mount
 };
 
 
 class VFS : public FS, public Singleton<VFS> {
 public:
+    VFS();
     void mount(char* point, FS* fs);
     vfs_lookup_t lookup(char* path);
     virtual StreamFile* open(char* path, int flags);
     virtual Directory* opendir(char* path);
     virtual void rename(char* opath, char* npath);
     virtual void unlink(char* path);
+    virtual void mkdir(char* path, int mode);
+    virtual void rmdir(char* path);
+    virtual int stat(char* path, struct stat* stat);
+    virtual int lstat(char* path, struct stat* stat);
 private:
-    Pool<mount_t*, 1024> mounts;
+    int query(char* path, struct stat* stat, bool link);
+    mount_node_t* mounts;
 };  
 
 
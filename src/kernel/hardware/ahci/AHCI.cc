@@ -0,0 +1,349 @@
+#include <hardware/ahci/AHCI.h>
+#include <memory/Memory.h>
+#include <kconfig.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <kutil.h>
+
+
+#define AHCI_PCI_CLASS 0x01
+#define AHCI_PCI_SUBCLASS 0x06
+#define AHCI_PCI_PROGIF 0x01
+#define AHCI_PCI_BAR 5
+
+#define AHCI_CAP_NCS(cap) ((((cap) >> 8) & 0x1f) + 1)
+#define AHCI_CAP_SNCQ (1u << 30)
+#define AHCI_GHC_IE (1 << 1)
+#define AHCI_GHC_AE (1u << 31)
+
+#define AHCI_PxCMD_ST (1 << 0)
+#define AHCI_PxCMD_FRE (1 << 4)
+#define AHCI_PxCMD_FR (1 << 14)
+#define AHCI_PxCMD_CR (1 << 15)
+#define AHCI_PxIS_DHRS (1 << 0)
+#define AHCI_PxIS_PSS (1 << 1)
+#define AHCI_PxIS_DSS (1 << 2)
+#define AHCI_PxIS_SDBS (1 << 3)
+#define AHCI_PxIS_TFES (1u << 30)
+#define AHCI_PxTFD_ERR 0x01
+#define AHCI_PxTFD_DRQ 0x08
+#define AHCI_PxTFD_BSY 0x80
+#define AHCI_SSTS_PRESENT 0x103
+#define AHCI_SIG_ATA 0x00000101
+
+#define AHCI_HEADER_WRITE (1 << 6)
+#define AHCI_PRD_INTERRUPT (1u << 31)
+#define AHCI_TIMEOUT 1000000
+
+#define FIS_TYPE_REG_H2D 0x27
+#define FIS_COMMAND 0x80
+#define FIS_DEVICE_LBA 0x40
+
+#define ATA_IDENTIFY 0xec
+#define ATA_READ_DMA_EXT 0x25
+#define ATA_WRITE_DMA_EXT 0x35
+#define ATA_READ_LOG_EXT 0x2f
+#define ATA_READ_FPDMA 0x60
+#define ATA_WRITE_FPDMA 0x61
+#define ATA_LOG_NCQ_ERROR 0x10
+
+#define TABLES_PER_PAGE (KCFG_PAGE_SIZE / sizeof(ahci_command_table_t))
+
+
+struct ahci_controller_t {
+    volatile ahci_hba_regs_t* hba;
+    AHCIDisk* disks[AHCI_MAX_PORTS];
+};
+
+
+static void ahci_interrupt(void* context) {
+    ahci_controller_t* c = (ahci_controller_t*)context;
+    uint32_t pending = c->hba->is;
+    if (!pending)
+        return;
+    for (int i = 0; i < AHCI_MAX_PORTS; i++)
+        if ((pending & (1u << i)) && c->disks[i])
+            c->disks[i]->handleInterrupt();
+    c->hba->is = pending;
+}
+
+
+AHCIDisk::AHCIDisk(volatile ahci_port_regs_t* p, const char* name) : BlockDevice(name, 0) {
+    port = p;
+    issued = 0;
+    memset(requests, 0, sizeof(requests));
+}
+
+int AHCIDisk::probe() {
+    int count = 0;
+    pci_device_t* d = NULL;
+    while ((d = PCI::get()->findClass(AHCI_PCI_CLASS, AHCI_PCI_SUBCLASS, d))) {
+        if (d->progIf != AHCI_PCI_PROGIF)
+            continue;
+        // INTx only: without a routed line nothing would ever complete
+        if (!d->irq || d->irq >= 16)
+            continue;
+
+        PCI::get()->enable(d, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+        volatile ahci_hba_regs_t* hba = (volatile ahci_hba_regs_t*)Memory::mapMMIO(
+            PCI::get()->getBAR(d, AHCI_PCI_BAR), sizeof(ahci_hba_regs_t));
+        if (!hba) {
+            klog('e', "AHCI: out of MMIO space");
+            continue;
+        }
+        hba->ghc |= AHCI_GHC_AE;
+
+        ahci_controller_t* c = new ahci_controller_t();
+        c->hba = hba;
+        uint32_t cap = hba->cap;
+        uint32_t implemented = hba->pi;
+        for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+            c->disks[i] = NULL;
+            volatile ahci_port_regs_t* port = &hba->ports[i];
+            if (!(implemented & (1u << i)) || (port->ssts & 0xf0f) != AHCI_SSTS_PRESENT)
+                continue;
+            if (port->sig != AHCI_SIG_ATA)
+                continue;
+
+            char name[8];
+            snprintf(name, sizeof(name), "sd%c", 'a' + count);
+            AHCIDisk* disk = new AHCIDisk(port, name);
+            if (!disk->init(AHCI_CAP_NCS(cap), cap & AHCI_CAP_SNCQ)) {
+                klog('e', "%s: initialization failed", name);
+                continue;
+            }
+            klog('i', "%s: %lu sectors, %s, queue depth %i", name, disk->sectors,
+                disk->ncq ? "NCQ" : "no NCQ", disk->queueDepth);
+            c->disks[i] = disk;
+            count++;
+        }
+
+        PCI::get()->addIRQHandler(d, ahci_interrupt, c);
+        hba->is = hba->is;
+        hba->ghc |= AHCI_GHC_IE;
+    }
+    return count;
+}
+
+bool AHCIDisk::init(uint32_t controllerSlots, bool ncqCapable) {
+    if (!stop())
+        return false;
+
+    // Command list and FIS receive area share a page with the buffer
+    // for polled commands; command tables are packed into pages of
+    // their own so each stays physically contiguous
+    uint64_t physical;
+    uint8_t* base = (uint8_t*)Memory::allocateDMA(KCFG_PAGE_SIZE, &physical);
+    if (!base)
+        return false;
+    headers = (volatile ahci_command_header_t*)base;
+    scratch = base + 2048;
+    scratchPhysical = physical + 2048;
+    port->clb = physical;
+    port->clbu = physical >> 32;
+    port->fb = physical + 1024;
+    port->fbu = (physical + 1024) >> 32;
+
+    slots = controllerSlots;
+    for (uint32_t i = 0; i < slots; i += TABLES_PER_PAGE) {
+        uint64_t tablePhysical;
+        ahci_command_table_t* t = (ahci_command_table_t*)Memory::allocateDMA(KCFG_PAGE_SIZE, &tablePhysical);
+        if (!t)
+            return false;
+        for (uint32_t j = 0; j < TABLES_PER_PAGE && i + j < slots; j++) {
+            tables[i + j] = t + j;
+            tablesPhysical[i + j] = tablePhysical + j * sizeof(ahci_command_table_t);
+            headers[i + j].ctba = tablesPhysical[i + j];
+        }
+    }
+
+    port->serr = 0xffffffff;
+    port->is = 0xffffffff;
+    port->ie = 0;
+    start();
+
+    if (!polled(ATA_IDENTIFY, 0, 0))
+        return false;
+
+    uint16_t* id = (uint16_t*)scratch;
+    if (id[83] & (1 << 10))
+        sectors = *(uint64_t*)&id[100];
+    else
+        sectors = *(uint32_t*)&id[60];
+
+    ncq = ncqCapable && (id[76] & (1 << 8));
+    if (ncq) {
+        uint32_t depth = (id[75] & 0x1f) + 1;
+        queueDepth = (depth < slots) ? depth : slots;
+    } else
+        queueDepth = 1;
+    // Every page of a merged request may need its own PRD, plus one
+    // for each segment that does not start on a page boundary
+    maxSegments = AHCI_PRDT_ENTRIES - KCFG_BLOCK_MAX_SECTORS * 512 / KCFG_PAGE_SIZE - 1;
+
+    port->is = 0xffffffff;
+    port->ie = AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_DSS | AHCI_PxIS_SDBS | AHCI_PxIS_TFES;
+    return true;
+}
+
+bool AHCIDisk::stop() {
+    port->cmd &= ~AHCI_PxCMD_ST;
+    for (int i = 0; i < AHCI_TIMEOUT && (port->cmd & AHCI_PxCMD_CR); i++);
+    port->cmd &= ~AHCI_PxCMD_FRE;
+    for (int i = 0; i < AHCI_TIMEOUT && (port->cmd & AHCI_PxCMD_FR); i++);
+    return !(port->cmd & (AHCI_PxCMD_CR | AHCI_PxCMD_FR));
+}
+
+void AHCIDisk::start() {
+    for (int i = 0; i < AHCI_TIMEOUT && (port->tfd & (AHCI_PxTFD_BSY | AHCI_PxTFD_DRQ)); i++);
+    port->cmd |= AHCI_PxCMD_FRE;
+    port->cmd |= AHCI_PxCMD_ST;
+}
+
+void AHCIDisk::setupFIS(int slot, uint8_t command, uint64_t lba, uint16_t count) {
+    fis_reg_h2d_t* fis = (fis_reg_h2d_t*)tables[slot]->cfis;
+    memset(fis, 0, sizeof(fis_reg_h2d_t));
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->flags = FIS_COMMAND;
+    fis->command = command;
+    fis->device = FIS_DEVICE_LBA;
+    fis->lba0 = lba;
+    fis->lba1 = lba >> 8;
+    fis->lba2 = lba >> 16;
+    fis->lba3 = lba >> 24;
+    fis->lba4 = lba >> 32;
+    fis->lba5 = lba >> 40;
+
+    // Queued commands carry the count in the feature registers and
+    // the tag in the count register
+    if (command == ATA_READ_FPDMA || command == ATA_WRITE_FPDMA) {
+        fis->featureLow = count;
+        fis->featureHigh = count >> 8;
+        fis->countLow = slot << 3;
+    } else {
+        fis->countLow = count;
+        fis->countHigh = count >> 8;
+    }
+}
+
+bool AHCIDisk::polled(uint8_t command, uint64_t lba, uint16_t count) {
+    // Slot 0 with the port otherwise idle, transferring one sector
+    // through the scratch buffer
+    setupFIS(0, command, lba, count);
+    tables[0]->prdt[0].dba = scratchPhysical;
+    tables[0]->prdt[0].dbc = 512 - 1;
+    headers[0].flags = sizeof(fis_reg_h2d_t) / 4;
+    headers[0].prdtl = 1;
+    headers[0].prdbc = 0;
+
+    port->ci = 1;
+    int i = 0;
+    while ((port->ci & 1) && !(port->is & AHCI_PxIS_TFES) && i++ < AHCI_TIMEOUT);
+    bool ok = !(port->ci & 1) && !(port->tfd & AHCI_PxTFD_ERR);
+    port->is = 0xffffffff;
+    return ok;
+}
+
+int AHCIDisk::build(int slot, block_request_t* r) {
+    ahci_command_table_t* t = tables[slot];
+    int count = 0;
+    for (block_request_t* s = r; s; s = s->nextSegment) {
+        uint64_t length = (uint64_t)s->count * 512;
+        uint64_t done = 0;
+        while (done < length) {
+            uint64_t physical = block_request_physical(s, done);
+            uint64_t c = KCFG_PAGE_SIZE - physical % KCFG_PAGE_SIZE;
+            if (c > length - done)
+                c = length - done;
+            if (physical & 1)
+                return -1;
+
+            // Extend the previous PRD when the memory carries on from it
+            ahci_prd_t* last = count ? &t->prdt[count - 1] : NULL;
+            if (last && last->dba + (last->dbc & 0x3fffff) + 1 == physical)
+                last->dbc += c;
+            else {
+                if (count == AHCI_PRDT_ENTRIES)
+                    return -1;
+                t->prdt[count].dba = physical;
+                t->prdt[count].reserved = 0;
+                t->prdt[count].dbc = c - 1;
+                count++;
+            }
+            done += c;
+        }
+    }
+    t->prdt[count - 1].dbc |= AHCI_PRD_INTERRUPT;
+    return count;
+}
+
+void AHCIDisk::dispatch(block_request_t* r) {
+    // The queue never has more requests out than there are slots
+    int slot = 0;
+    while (issued & (1u << slot))
+        slot++;
+
+    int count = build(slot, r);
+    if (count < 0) {
+        complete(r, EIO);
+        return;
+    }
+
+    uint8_t command;
+    if (ncq)
+        command = (r->op == BLOCK_READ) ? ATA_READ_FPDMA : ATA_WRITE_FPDMA;
+    else
+        command = (r->op == BLOCK_READ) ? ATA_READ_DMA_EXT : ATA_WRITE_DMA_EXT;
+    setupFIS(slot, command, r->sector, r->totalCount);
+    headers[slot].flags = sizeof(fis_reg_h2d_t) / 4 | ((r->op == BLOCK_WRITE) ? AHCI_HEADER_WRITE : 0);
+    headers[slot].prdtl = count;
+    headers[slot].prdbc = 0;
+
+    requests[slot] = r;
+    issued |= 1u << slot;
+    __sync_synchronize();
+    if (ncq)
+        port->sact = 1u << slot;
+    port->ci = 1u << slot;
+}
+
+void AHCIDisk::handleInterrupt() {
+    uint32_t status = port->is;
+    port->is = status;
+    if (status & AHCI_PxIS_TFES) {
+        recover();
+        return;
+    }
+
+    // A queued command is done once the drive clears its SACT bit; a
+    // plain one once the controller clears CI
+    uint32_t finished = issued & ~(port->sact | port->ci);
+    for (uint32_t slot = 0; slot < slots; slot++)
+        if (finished & (1u << slot)) {
+            block_request_t* r = requests[slot];
+            requests[slot] = NULL;
+            issued &= ~(1u << slot);
+            complete(r, 0);
+        }
+}
+
+void AHCIDisk::recover() {
+    // The drive does not say which queued command failed until its
+    // error log is read, so everything outstanding fails with EIO
+    stop();
+    port->serr = 0xffffffff;
+    port->is = 0xffffffff;
+    start();
+    uint32_t failed = issued;
+    issued = 0;
+    if (ncq)
+        polled(ATA_READ_LOG_EXT, ATA_LOG_NCQ_ERROR, 1);
+
+    for (uint32_t slot = 0; slot < slots; slot++)
+        if (failed & (1u << slot)) {
+            block_request_t* r = requests[slot];
+            requests[slot] = NULL;
+            complete(r, EIO);
+        }
+}
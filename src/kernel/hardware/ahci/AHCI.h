@@ -0,0 +1,107 @@
+#ifndef HARDWARE_AHCI_AHCI_H
+#define HARDWARE_AHCI_AHCI_H
+
+#include <lang/lang.h>
+#include <block/BlockDevice.h>
+#include <hardware/pci/PCI.h>
+
+
+#define AHCI_MAX_PORTS 32
+#define AHCI_PRDT_ENTRIES 56
+
+
+struct ahci_port_regs_t {
+    uint32_t clb, clbu;
+    uint32_t fb, fbu;
+    uint32_t is, ie;
+    uint32_t cmd;
+    uint32_t reserved0;
+    uint32_t tfd;
+    uint32_t sig;
+    uint32_t ssts, sctl, serr;
+    uint32_t sact, ci;
+    uint32_t sntf, fbs;
+    uint32_t reserved1[11];
+    uint32_t vendor[4];
+} __attribute__((packed));
+
+struct ahci_hba_regs_t {
+    uint32_t cap, ghc, is, pi, vs;
+    uint32_t cccCtl, cccPorts;
+    uint32_t emLoc, emCtl;
+    uint32_t cap2, bohc;
+    uint8_t reserved[0xa0 - 0x2c];
+    uint8_t vendor[0x100 - 0xa0];
+    ahci_port_regs_t ports[AHCI_MAX_PORTS];
+} __attribute__((packed));
+
+struct ahci_command_header_t {
+    uint16_t flags;
+    uint16_t prdtl;
+    uint32_t prdbc;
+    uint64_t ctba;
+    uint32_t reserved[4];
+} __attribute__((packed));
+
+struct ahci_prd_t {
+    uint64_t dba;
+    uint32_t reserved;
+    uint32_t dbc;
+} __attribute__((packed));
+
+struct ahci_command_table_t {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    ahci_prd_t prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed));
+
+struct fis_reg_h2d_t {
+    uint8_t type;
+    uint8_t flags;
+    uint8_t command;
+    uint8_t featureLow;
+    uint8_t lba0, lba1, lba2;
+    uint8_t device;
+    uint8_t lba3, lba4, lba5;
+    uint8_t featureHigh;
+    uint8_t countLow, countHigh;
+    uint8_t icc;
+    uint8_t control;
+    uint32_t reserved;
+} __attribute__((packed));
+
+
+// A SATA disk on an AHCI port. With NCQ every command slot the drive
+// and controller support carries its own request, tagged by slot;
+// otherwise the port runs one DMA command at a time
+class AHCIDisk : public BlockDevice {
+public:
+    AHCIDisk(volatile ahci_port_regs_t* port, const char* name);
+    // Sets up every disk behind every AHCI controller and returns how many
+    static int probe();
+    void handleInterrupt();
+protected:
+    virtual void dispatch(block_request_t* r);
+private:
+    bool init(uint32_t slots, bool ncqCapable);
+    bool stop();
+    void start();
+    bool polled(uint8_t command, uint64_t lba, uint16_t count);
+    int build(int slot, block_request_t* r);
+    void setupFIS(int slot, uint8_t command, uint64_t lba, uint16_t count);
+    void recover();
+
+    volatile ahci_port_regs_t* port;
+    volatile ahci_command_header_t* headers;
+    ahci_command_table_t* tables[AHCI_MAX_PORTS];
+    uint64_t tablesPhysical[AHCI_MAX_PORTS];
+    uint8_t* scratch;
+    uint64_t scratchPhysical;
+    block_request_t* requests[AHCI_MAX_PORTS];
+    uint32_t slots;
+    uint32_t issued;
+    bool ncq;
+};
+
+#endif
@@ -16,6 +16,23 @@ void ata_init() {
 
 }
 
+uint64_t ata_sectors() {
+    outb(0x1f6, 0xa0);
+    outb(0x1f7, 0xec);
+    uint8_t status = inb(0x1f7);
+    if (!status || status == 0xff)
+        return 0;
+
+    while (inb(0x1f7) & 0x80);
+    while ((inb(0x1f7) & 9) == 0);
+    if (inb(0x1f7) & 1)
+        return 0;
+
+    uint16_t identify[256];
+    asm("rep insw" : : "c"(256), "d"(0x1f0), "D"(identify) : "memory");
+    return identify[60] | ((uint64_t)identify[61] << 16);
+}
+
 void ata_read(uint64_t lba, uint8_t* buf) {
 //    klog('t', "ATA cache miss %lx", lba);
 
@@ -49,5 +66,19 @@ void ata_write(uint64_t lba, uint8_t* buf) {
     while ((inb(0x1f7) & 8) == 0);
 
     asm("rep outsw" : : "c"(256), "d"(0x1f0), "S"(buf));
-    klog_flush();
+}
+
+
+ATADevice::ATADevice() : BlockDevice("hda", ata_sectors()) {
+}
+
+void ATADevice::dispatch(block_request_t* r) {
+    for (block_request_t* s = r; s; s = s->nextSegment)
+        for (uint32_t i = 0; i < s->count; i++) {
+            if (s->op == BLOCK_READ)
+                ata_read(s->sector + i, s->buffer + 512 * i);
+            else
+                ata_write(s->sector + i, s->buffer + 512 * i);
+        }
+    complete(r, 0);
 }
@@ -2,9 +2,21 @@
 #define HARDWARE_ATA_ATA_H
 
 #include <lang/lang.h>
+#include <block/BlockDevice.h>
 
 void ata_init();
+uint64_t ata_sectors();
 void ata_read(uint64_t lba, uint8_t* buf);
 void ata_write(uint64_t lba, uint8_t* buf);
 
+
+// The primary master, driven by PIO: every request is transferred
+// before dispatch() returns
+class ATADevice : public BlockDevice {
+public:
+    ATADevice();
+protected:
+    virtual void dispatch(block_request_t* r);
+};
+
 #endif
\ No newline at end of file
@@ -15,6 +15,13 @@ uint16_t inw(uint16_t port) {
     return ret;
 }
 
+uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile("inl %1, %0"
+                  : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
 void outb(uint16_t port, uint8_t val) {
     asm volatile("outb %0, %1"
                   : : "a"(val), "Nd"(port));
@@ -25,3 +32,8 @@ void outw(uint16_t port, uint16_t val) {
     asm volatile("outw %0, %1"
                   : : "a"(val), "Nd"(port));
 }
+
+void outl(uint16_t port, uint32_t val) {
+    asm volatile("outl %0, %1"
+                  : : "a"(val), "Nd"(port));
+}
@@ -5,7 +5,9 @@
 
 uint8_t inb(uint16_t port);
 uint16_t inw(uint16_t port);
+uint32_t inl(uint16_t port);
 void outb(uint16_t port, uint8_t val);
 void outw(uint16_t port, uint16_t val);
+void outl(uint16_t port, uint32_t val);
 
 #endif
\ No newline at end of file
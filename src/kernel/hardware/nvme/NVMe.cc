@@ -0,0 +1,380 @@
+#include <hardware/nvme/NVMe.h>
+#include <alloc/malloc.h>
+#include <core/CPU.h>
+#include <memory/Memory.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <kutil.h>
+
+
+#define NVME_PCI_CLASS 0x01
+#define NVME_PCI_SUBCLASS 0x08
+#define NVME_PCI_PROGIF 0x02
+
+#define NVME_CAP 0x00
+#define NVME_CC 0x14
+#define NVME_CSTS 0x1c
+#define NVME_AQA 0x24
+#define NVME_ASQ 0x28
+#define NVME_ACQ 0x30
+#define NVME_DOORBELLS 0x1000
+
+#define NVME_CAP_MQES(cap) ((cap) & 0xffff)
+#define NVME_CAP_DSTRD(cap) (((cap) >> 32) & 0xf)
+#define NVME_CAP_MPSMIN(cap) (((cap) >> 48) & 0xf)
+#define NVME_CC_EN 1
+#define NVME_CC_IOSQES (6 << 16)
+#define NVME_CC_IOCQES (4 << 20)
+#define NVME_CSTS_RDY 1
+#define NVME_CSTS_CFS 2
+
+#define NVME_ADMIN_CREATE_SQ 0x01
+#define NVME_ADMIN_CREATE_CQ 0x05
+#define NVME_ADMIN_IDENTIFY 0x06
+#define NVME_ADMIN_SET_FEATURES 0x09
+#define NVME_FEATURE_QUEUES 0x07
+#define NVME_IDENTIFY_NAMESPACE 0
+#define NVME_IDENTIFY_CONTROLLER 1
+#define NVME_QUEUE_CONTIGUOUS 1
+#define NVME_QUEUE_IRQ 2
+
+#define NVME_CMD_WRITE 0x01
+#define NVME_CMD_READ 0x02
+
+#define NVME_PHASE(status) ((status) & 1)
+#define NVME_FAILED(status) ((status) >> 1)
+#define NVME_NAMESPACE 1
+#define NVME_TIMEOUT 10000000
+
+#define REG32(offset) (*(volatile uint32_t*)(regs + (offset)))
+#define REG64(offset) (*(volatile uint64_t*)(regs + (offset)))
+
+
+// Segments go in one command while each ends on a page boundary and
+// the next starts on one: PRP entries past the first are whole pages
+static bool joins(block_request_t* s) {
+    return s->nextSegment
+        && (uint64_t)(s->buffer + (uint64_t)s->count * 512) % KCFG_PAGE_SIZE == 0
+        && (uint64_t)s->nextSegment->buffer % KCFG_PAGE_SIZE == 0;
+}
+
+static void advance(nvme_queue_t* q) {
+    q->cqHead++;
+    if (q->cqHead == q->entries) {
+        q->cqHead = 0;
+        q->phase ^= 1;
+    }
+}
+
+
+NVMeDisk::NVMeDisk(pci_device_t* d, const char* name) : BlockDevice(name, 0) {
+    pci = d;
+    adminID = 0;
+    queueCount = 0;
+    waiting = NULL;
+}
+
+int NVMeDisk::probe() {
+    int count = 0;
+    pci_device_t* d = NULL;
+    while ((d = PCI::get()->findClass(NVME_PCI_CLASS, NVME_PCI_SUBCLASS, d))) {
+        if (d->progIf != NVME_PCI_PROGIF)
+            continue;
+        char name[16];
+        snprintf(name, sizeof(name), "nvme%in%i", count, NVME_NAMESPACE);
+        NVMeDisk* disk = new NVMeDisk(d, name);
+        if (!disk->init()) {
+            klog('e', "%s: initialization failed", name);
+            continue;
+        }
+        klog('i', "%s: %lu sectors, %i I/O queue(s) of %i, %s", name, disk->sectors,
+            disk->queueCount, disk->entries, disk->polling ? "polled" : "interrupts");
+        count++;
+    }
+    return count;
+}
+
+bool NVMeDisk::init() {
+    PCI::get()->enable(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    uint64_t bar = PCI::get()->getBAR(pci, 0);
+    regs = (volatile uint8_t*)Memory::mapMMIO(bar, NVME_DOORBELLS);
+    if (!regs)
+        return false;
+
+    uint64_t cap = REG64(NVME_CAP);
+    if (NVME_CAP_MPSMIN(cap) > 0)
+        return false;
+    doorbellStride = 4 << NVME_CAP_DSTRD(cap);
+    doorbells = (volatile uint8_t*)Memory::mapMMIO(bar + NVME_DOORBELLS, 2 * (KCFG_MAX_CPUS + 1) * doorbellStride);
+    if (!doorbells)
+        return false;
+    entries = NVME_QUEUE_ENTRIES;
+    if (NVME_CAP_MQES(cap) + 1 < entries)
+        entries = NVME_CAP_MQES(cap) + 1;
+
+    // Reset, then hand the controller its admin queues
+    REG32(NVME_CC) = 0;
+    if (!waitReady(false))
+        return false;
+    if (!setupQueue(&adminQueue, 0, entries))
+        return false;
+    REG32(NVME_AQA) = ((entries - 1) << 16) | (entries - 1);
+    REG32(NVME_ASQ) = adminQueue.sqPhysical;
+    REG32(NVME_ASQ + 4) = adminQueue.sqPhysical >> 32;
+    REG32(NVME_ACQ) = adminQueue.cqPhysical;
+    REG32(NVME_ACQ + 4) = adminQueue.cqPhysical >> 32;
+    REG32(NVME_CC) = NVME_CC_EN | NVME_CC_IOSQES | NVME_CC_IOCQES;
+    if (!waitReady(true))
+        return false;
+
+    identify = (uint8_t*)Memory::allocateDMA(KCFG_PAGE_SIZE, &identifyPhysical);
+    if (!identify)
+        return false;
+
+    nvme_command_t c;
+    memset(&c, 0, sizeof(c));
+    c.opcode = NVME_ADMIN_IDENTIFY;
+    c.prp1 = identifyPhysical;
+    c.cdw10 = NVME_IDENTIFY_CONTROLLER;
+    if (!admin(&c, NULL))
+        return false;
+    // Largest transfer as a power of two of the page size, 0 if none
+    uint8_t mdts = identify[77];
+    if (mdts && ((uint64_t)KCFG_PAGE_SIZE << mdts) < KCFG_BLOCK_MAX_SECTORS * 512)
+        return false;
+
+    memset(&c, 0, sizeof(c));
+    c.opcode = NVME_ADMIN_IDENTIFY;
+    c.nsid = NVME_NAMESPACE;
+    c.prp1 = identifyPhysical;
+    c.cdw10 = NVME_IDENTIFY_NAMESPACE;
+    if (!admin(&c, NULL))
+        return false;
+    uint8_t format = identify[26] & 0xf;
+    uint32_t lbaFormat = *(uint32_t*)(identify + 128 + 4 * format);
+    if (((lbaFormat >> 16) & 0xff) != 9) {
+        klog('e', "%s: only 512-byte LBA formats are supported", name);
+        return false;
+    }
+    sectors = *(uint64_t*)identify;
+
+    // One queue pair per CPU, or as many as the controller grants
+    memset(&c, 0, sizeof(c));
+    c.opcode = NVME_ADMIN_SET_FEATURES;
+    c.cdw10 = NVME_FEATURE_QUEUES;
+    c.cdw11 = ((KCFG_MAX_CPUS - 1) << 16) | (KCFG_MAX_CPUS - 1);
+    uint32_t granted;
+    if (!admin(&c, &granted))
+        return false;
+    queueCount = KCFG_MAX_CPUS;
+    if ((int)(granted & 0xffff) + 1 < queueCount)
+        queueCount = (granted & 0xffff) + 1;
+    if ((int)(granted >> 16) + 1 < queueCount)
+        queueCount = (granted >> 16) + 1;
+
+    polling = !pci->irq || pci->irq >= 16;
+    for (int i = 0; i < queueCount; i++) {
+        nvme_queue_t* q = &queues[i];
+        if (!setupQueue(q, i + 1, entries))
+            return false;
+
+        memset(&c, 0, sizeof(c));
+        c.opcode = NVME_ADMIN_CREATE_CQ;
+        c.prp1 = q->cqPhysical;
+        c.cdw10 = ((entries - 1) << 16) | q->id;
+        c.cdw11 = NVME_QUEUE_CONTIGUOUS | (polling ? 0 : NVME_QUEUE_IRQ);
+        if (!admin(&c, NULL))
+            return false;
+
+        memset(&c, 0, sizeof(c));
+        c.opcode = NVME_ADMIN_CREATE_SQ;
+        c.prp1 = q->sqPhysical;
+        c.cdw10 = ((entries - 1) << 16) | q->id;
+        c.cdw11 = (q->id << 16) | NVME_QUEUE_CONTIGUOUS;
+        if (!admin(&c, NULL))
+            return false;
+    }
+
+    // Requests split into several commands wait for room in dispatch();
+    // capping segments makes sure an idle queue always has enough
+    queueDepth = entries - 1;
+    maxSegments = entries - 1;
+    if (!polling)
+        PCI::get()->addIRQHandler(pci, interrupt, this);
+    return true;
+}
+
+bool NVMeDisk::waitReady(bool ready) {
+    for (int i = 0; i < NVME_TIMEOUT; i++) {
+        uint32_t status = REG32(NVME_CSTS);
+        if (status & NVME_CSTS_CFS)
+            return false;
+        if (((status & NVME_CSTS_RDY) != 0) == ready)
+            return true;
+    }
+    return false;
+}
+
+bool NVMeDisk::setupQueue(nvme_queue_t* q, uint16_t id, uint16_t count) {
+    memset(q, 0, sizeof(nvme_queue_t));
+    q->id = id;
+    q->entries = count;
+    q->phase = 1;
+    q->freeSlots = (1ULL << (count - 1)) - 1;
+    q->sq = (nvme_command_t*)Memory::allocateDMA(sizeof(nvme_command_t) * count, &q->sqPhysical);
+    q->cq = (volatile nvme_completion_t*)Memory::allocateDMA(sizeof(nvme_completion_t) * count, &q->cqPhysical);
+    // Each list sits within one page, so the area as a whole does not
+    // have to be physically contiguous
+    q->prpLists = (uint64_t*)kvalloc(sizeof(uint64_t) * NVME_PRP_ENTRIES * count);
+    q->sqDoorbell = (volatile uint32_t*)(doorbells + 2 * id * doorbellStride);
+    q->cqDoorbell = (volatile uint32_t*)(doorbells + (2 * id + 1) * doorbellStride);
+    return q->sq && q->cq && q->prpLists;
+}
+
+void NVMeDisk::post(nvme_queue_t* q, nvme_command_t* c) {
+    memcpy(&q->sq[q->sqTail], c, sizeof(nvme_command_t));
+    q->sqTail = (q->sqTail + 1) % q->entries;
+    __sync_synchronize();
+    *q->sqDoorbell = q->sqTail;
+}
+
+bool NVMeDisk::admin(nvme_command_t* c, uint32_t* result) {
+    // Admin commands only run during setup, so they are polled
+    nvme_queue_t* q = &adminQueue;
+    c->cid = adminID++;
+    post(q, c);
+    for (int i = 0; i < NVME_TIMEOUT; i++) {
+        volatile nvme_completion_t* e = &q->cq[q->cqHead];
+        if (NVME_PHASE(e->status) != q->phase)
+            continue;
+        bool ok = !NVME_FAILED(e->status);
+        if (result)
+            *result = e->result;
+        advance(q);
+        *q->cqDoorbell = q->cqHead;
+        return ok;
+    }
+    return false;
+}
+
+void NVMeDisk::dispatch(block_request_t* r) {
+    // Requests that need more commands than the queue has room for
+    // wait for completions, in order
+    if (!waiting && start(r))
+        return;
+    r->next = NULL;
+    block_request_t** p = &waiting;
+    while (*p)
+        p = &(*p)->next;
+    *p = r;
+}
+
+bool NVMeDisk::start(block_request_t* r) {
+    nvme_queue_t* q = &queues[CPU::getID() % queueCount];
+
+    int needed = 0;
+    for (block_request_t* s = r; s; s = s->nextSegment) {
+        if ((uint64_t)s->buffer & 3) {
+            complete(r, EIO);
+            return true;
+        }
+        if (!joins(s))
+            needed++;
+    }
+    if (needed > __builtin_popcountll(q->freeSlots))
+        return false;
+
+    block_request_t* s = r;
+    while (s) {
+        int slot = __builtin_ctzll(q->freeSlots);
+        q->freeSlots &= ~(1ULL << slot);
+        q->requests[slot] = r;
+        uint64_t* list = &q->prpLists[slot * NVME_PRP_ENTRIES];
+
+        nvme_command_t c;
+        memset(&c, 0, sizeof(c));
+        c.opcode = (r->op == BLOCK_READ) ? NVME_CMD_READ : NVME_CMD_WRITE;
+        c.cid = slot;
+        c.nsid = NVME_NAMESPACE;
+        c.cdw10 = s->sector;
+        c.cdw11 = s->sector >> 32;
+
+        uint32_t count = 0;
+        int pages = 0;
+        bool more = true;
+        while (more) {
+            uint64_t length = (uint64_t)s->count * 512;
+            for (uint64_t done = 0; done < length;) {
+                uint64_t physical = block_request_physical(s, done);
+                if (pages)
+                    list[pages - 1] = physical;
+                else
+                    c.prp1 = physical;
+                pages++;
+                done += KCFG_PAGE_SIZE - physical % KCFG_PAGE_SIZE;
+            }
+            count += s->count;
+            more = joins(s);
+            s = s->nextSegment;
+        }
+        if (pages == 2)
+            c.prp2 = list[0];
+        else if (pages > 2)
+            c.prp2 = Memory::getPhysical(list);
+        c.cdw12 = count - 1;
+        post(q, &c);
+    }
+    return true;
+}
+
+void NVMeDisk::reap(nvme_queue_t* q) {
+    bool reaped = false;
+    while (NVME_PHASE(q->cq[q->cqHead].status) == q->phase) {
+        volatile nvme_completion_t* e = &q->cq[q->cqHead];
+        uint16_t slot = e->cid;
+        bool failed = NVME_FAILED(e->status);
+        advance(q);
+        reaped = true;
+
+        block_request_t* r = q->requests[slot];
+        q->requests[slot] = NULL;
+        q->freeSlots |= 1ULL << slot;
+        if (failed)
+            r->status = EIO;
+
+        // Done once none of its commands is left
+        bool pending = false;
+        for (int i = 0; i < q->entries; i++)
+            if (q->requests[i] == r)
+                pending = true;
+        if (!pending)
+            complete(r, r->status);
+    }
+    if (reaped)
+        *q->cqDoorbell = q->cqHead;
+}
+
+void NVMeDisk::reapAll() {
+    for (int i = 0; i < queueCount; i++)
+        reap(&queues[i]);
+
+    while (waiting) {
+        block_request_t* r = waiting;
+        waiting = r->next;
+        if (!start(r)) {
+            r->next = waiting;
+            waiting = r;
+            break;
+        }
+    }
+}
+
+void NVMeDisk::poll() {
+    if (polling)
+        reapAll();
+}
+
+void NVMeDisk::interrupt(void* context) {
+    ((NVMeDisk*)context)->reapAll();
+}
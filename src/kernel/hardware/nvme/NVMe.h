@@ -0,0 +1,91 @@
+#ifndef HARDWARE_NVME_NVME_H
+#define HARDWARE_NVME_NVME_H
+
+#include <lang/lang.h>
+#include <kconfig.h>
+#include <block/BlockDevice.h>
+#include <hardware/pci/PCI.h>
+
+
+#define NVME_QUEUE_ENTRIES 64
+#define NVME_PRP_ENTRIES 64
+
+
+struct nvme_command_t {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint64_t reserved;
+    uint64_t metadata;
+    uint64_t prp1, prp2;
+    uint32_t cdw10, cdw11, cdw12, cdw13, cdw14, cdw15;
+} __attribute__((packed));
+
+struct nvme_completion_t {
+    uint32_t result;
+    uint32_t reserved;
+    uint16_t sqHead;
+    uint16_t sqId;
+    uint16_t cid;
+    uint16_t status;
+} __attribute__((packed));
+
+// A submission queue and the completion queue it posts to. Command
+// IDs index requests[] and prpLists; one entry is always left unused
+// so a full queue never looks empty
+struct nvme_queue_t {
+    uint16_t id;
+    uint16_t entries;
+    nvme_command_t* sq;
+    volatile nvme_completion_t* cq;
+    uint64_t sqPhysical, cqPhysical;
+    volatile uint32_t* sqDoorbell;
+    volatile uint32_t* cqDoorbell;
+    uint16_t sqTail, cqHead;
+    uint16_t phase;
+    uint64_t freeSlots;
+    block_request_t* requests[NVME_QUEUE_ENTRIES];
+    uint64_t* prpLists;
+};
+
+
+// Namespace 1 of an NVMe controller. Each CPU submits on its own I/O
+// queue pair; a request whose segments cannot share one PRP list is
+// sent as several commands and completes when the last one does.
+// Without a usable interrupt line completions are polled
+class NVMeDisk : public BlockDevice {
+public:
+    NVMeDisk(pci_device_t* pci, const char* name);
+    // Sets up every NVMe controller on the PCI bus and returns how many
+    static int probe();
+    virtual void poll();
+protected:
+    virtual void dispatch(block_request_t* r);
+private:
+    bool init();
+    bool waitReady(bool ready);
+    bool setupQueue(nvme_queue_t* q, uint16_t id, uint16_t entries);
+    bool admin(nvme_command_t* c, uint32_t* result);
+    void post(nvme_queue_t* q, nvme_command_t* c);
+    bool start(block_request_t* r);
+    void reap(nvme_queue_t* q);
+    void reapAll();
+    static void interrupt(void* context);
+
+    pci_device_t* pci;
+    volatile uint8_t* regs;
+    volatile uint8_t* doorbells;
+    uint32_t doorbellStride;
+    uint16_t entries;
+    uint16_t adminID;
+    nvme_queue_t adminQueue;
+    nvme_queue_t queues[KCFG_MAX_CPUS];
+    int queueCount;
+    bool polling;
+    uint8_t* identify;
+    uint64_t identifyPhysical;
+    block_request_t* waiting;
+};
+
+#endif
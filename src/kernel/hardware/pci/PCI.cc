@@ -0,0 +1,148 @@
+#include <hardware/pci/PCI.h>
+#include <hardware/io.h>
+#include <interrupts/Interrupts.h>
+#include <kutil.h>
+
+
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+#define PCI_MAX_IRQ_HANDLERS 16
+
+
+struct pci_irq_entry_t {
+    uint8_t line;
+    pci_irq_handler_t handler;
+    void* context;
+};
+
+static pci_irq_entry_t irqHandlers[PCI_MAX_IRQ_HANDLERS];
+static int irqHandlerCount = 0;
+
+
+static void select(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000 | (bus << 16) | (slot << 11) | (function << 8) | (offset & 0xfc));
+}
+
+static uint32_t config_read(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    select(bus, slot, function, offset);
+    return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_irq(isrq_registers_t* regs) {
+    for (int i = 0; i < irqHandlerCount; i++)
+        if (irqHandlers[i].line == regs->int_no)
+            irqHandlers[i].handler(irqHandlers[i].context);
+}
+
+
+void PCI::scan() {
+    devices = NULL;
+    pci_device_t** tail = &devices;
+
+    for (int bus = 0; bus < 256; bus++)
+        for (int slot = 0; slot < 32; slot++)
+            for (int function = 0; function < 8; function++) {
+                uint32_t id = config_read(bus, slot, function, 0);
+                if ((id & 0xffff) == 0xffff) {
+                    if (!function)
+                        break;
+                    continue;
+                }
+
+                pci_device_t* d = new pci_device_t();
+                d->bus = bus;
+                d->slot = slot;
+                d->function = function;
+                d->vendor = id & 0xffff;
+                d->device = id >> 16;
+                uint32_t classes = config_read(bus, slot, function, 0x08);
+                d->classCode = classes >> 24;
+                d->subclass = (classes >> 16) & 0xff;
+                d->progIf = (classes >> 8) & 0xff;
+                d->irq = config_read(bus, slot, function, PCI_INTERRUPT_LINE) & 0xff;
+                d->next = NULL;
+                *tail = d;
+                tail = &d->next;
+
+                klog('i', "PCI %02x:%02x.%i %04x:%04x class %02x:%02x irq %i",
+                    bus, slot, function, d->vendor, d->device, d->classCode, d->subclass, d->irq);
+
+                // Only multi-function devices have anything past function 0
+                if (!function && !((config_read(bus, slot, 0, 0x0c) >> 16) & 0x80))
+                    break;
+            }
+}
+
+pci_device_t* PCI::find(uint16_t vendor, uint16_t device, pci_device_t* after) {
+    for (pci_device_t* d = after ? after->next : devices; d; d = d->next)
+        if (d->vendor == vendor && d->device == device)
+            return d;
+    return NULL;
+}
+
+pci_device_t* PCI::findClass(uint8_t classCode, uint8_t subclass, pci_device_t* after) {
+    for (pci_device_t* d = after ? after->next : devices; d; d = d->next)
+        if (d->classCode == classCode && d->subclass == subclass)
+            return d;
+    return NULL;
+}
+
+uint32_t PCI::read32(pci_device_t* d, uint8_t offset) {
+    return config_read(d->bus, d->slot, d->function, offset);
+}
+
+uint16_t PCI::read16(pci_device_t* d, uint8_t offset) {
+    return read32(d, offset) >> ((offset & 2) * 8);
+}
+
+uint8_t PCI::read8(pci_device_t* d, uint8_t offset) {
+    return read32(d, offset) >> ((offset & 3) * 8);
+}
+
+void PCI::write32(pci_device_t* d, uint8_t offset, uint32_t value) {
+    select(d->bus, d->slot, d->function, offset);
+    outl(PCI_CONFIG_DATA, value);
+}
+
+void PCI::write16(pci_device_t* d, uint8_t offset, uint16_t value) {
+    select(d->bus, d->slot, d->function, offset);
+    outw(PCI_CONFIG_DATA + (offset & 2), value);
+}
+
+uint64_t PCI::getBAR(pci_device_t* d, int index) {
+    uint32_t bar = read32(d, PCI_BAR0 + 4 * index);
+    if (bar & 1)
+        return bar & ~3;
+    uint64_t address = bar & ~0xf;
+    if ((bar & 6) == 4)
+        address |= (uint64_t)read32(d, PCI_BAR0 + 4 * (index + 1)) << 32;
+    return address;
+}
+
+void PCI::enable(pci_device_t* d, uint16_t command) {
+    write16(d, PCI_COMMAND, read16(d, PCI_COMMAND) | command);
+}
+
+uint8_t PCI::findCapability(pci_device_t* d, uint8_t id) {
+    if (!(read16(d, 0x06) & 0x10))
+        return 0;
+    uint8_t offset = read8(d, PCI_CAPABILITIES) & 0xfc;
+    while (offset) {
+        if (read8(d, offset) == id)
+            return offset;
+        offset = read8(d, offset + 1) & 0xfc;
+    }
+    return 0;
+}
+
+void PCI::addIRQHandler(pci_device_t* d, pci_irq_handler_t handler, void* context) {
+    if (irqHandlerCount == PCI_MAX_IRQ_HANDLERS) {
+        klog('e', "PCI: out of IRQ handler slots");
+        return;
+    }
+    irqHandlers[irqHandlerCount].line = d->irq;
+    irqHandlers[irqHandlerCount].handler = handler;
+    irqHandlers[irqHandlerCount].context = context;
+    irqHandlerCount++;
+    Interrupts::get()->setHandler(IRQ(d->irq), pci_irq);
+}
@@ -0,0 +1,56 @@
+#ifndef HARDWARE_PCI_PCI_H
+#define HARDWARE_PCI_PCI_H
+
+#include <lang/lang.h>
+#include <lang/Singleton.h>
+
+
+#define PCI_COMMAND 0x04
+#define PCI_BAR0 0x10
+#define PCI_CAPABILITIES 0x34
+#define PCI_INTERRUPT_LINE 0x3c
+
+#define PCI_COMMAND_IO 0x1
+#define PCI_COMMAND_MEMORY 0x2
+#define PCI_COMMAND_MASTER 0x4
+#define PCI_COMMAND_INTX_DISABLE 0x400
+
+
+struct pci_device_t {
+    uint8_t bus, slot, function;
+    uint16_t vendor, device;
+    uint8_t classCode, subclass, progIf;
+    uint8_t irq;
+    pci_device_t* next;
+};
+
+typedef void (*pci_irq_handler_t)(void* context);
+
+
+class PCI : public Singleton<PCI> {
+public:
+    void scan();
+    pci_device_t* find(uint16_t vendor, uint16_t device, pci_device_t* after = 0);
+    pci_device_t* findClass(uint8_t classCode, uint8_t subclass, pci_device_t* after = 0);
+
+    uint32_t read32(pci_device_t* d, uint8_t offset);
+    uint16_t read16(pci_device_t* d, uint8_t offset);
+    uint8_t read8(pci_device_t* d, uint8_t offset);
+    void write32(pci_device_t* d, uint8_t offset, uint32_t value);
+    void write16(pci_device_t* d, uint8_t offset, uint16_t value);
+
+    // BAR contents without the type bits; 64-bit BARs are combined
+    // with the following register
+    uint64_t getBAR(pci_device_t* d, int index);
+    void enable(pci_device_t* d, uint16_t command);
+    // Offset of the capability with the given ID, or 0
+    uint8_t findCapability(pci_device_t* d, uint8_t id);
+
+    // INTx lines are shared, so every handler registered for a line
+    // runs on its interrupt and checks its own device
+    void addIRQHandler(pci_device_t* d, pci_irq_handler_t handler, void* context);
+
+    pci_device_t* devices;
+};
+
+#endif
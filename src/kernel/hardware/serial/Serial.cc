@@ -0,0 +1,110 @@
+#include <hardware/serial/Serial.h>
+#include <hardware/io.h>
+#include <kutil.h>
+
+
+#define REG_DATA    0
+#define REG_IER     1
+#define REG_IIR     2
+#define REG_FCR     2
+#define REG_LCR     3
+#define REG_MCR     4
+#define REG_LSR     5
+
+#define IER_RX      0x01
+#define IER_THRE    0x02
+#define LSR_RX      0x01
+#define LSR_THRE    0x20
+#define IIR_NONE    0x01
+
+#define FIFO_SIZE   16
+
+// Buffers are single producer/single consumer rings; the non-IRQ side
+// always runs with interrupts disabled (syscalls, klogd).
+
+
+static void serialh(isrq_registers_t* r) {
+    Serial::get()->handle(r);
+}
+
+void Serial::init() {
+    txHead = txTail = rxHead = rxTail = 0;
+
+    outb(SERIAL_COM1 + REG_IER, 0x00);
+    outb(SERIAL_COM1 + REG_LCR, 0x80);      // DLAB
+    outb(SERIAL_COM1 + REG_DATA, 0x01);     // 115200 baud
+    outb(SERIAL_COM1 + REG_IER, 0x00);
+    outb(SERIAL_COM1 + REG_LCR, 0x03);      // 8N1
+    outb(SERIAL_COM1 + REG_FCR, 0xc7);      // enable and clear FIFOs, 14-byte RX trigger
+    outb(SERIAL_COM1 + REG_MCR, 0x0b);      // DTR, RTS, OUT2 (IRQ line)
+
+    // No UART behind the port reads back as 0xff
+    ready = (inb(SERIAL_COM1 + REG_LSR) != 0xff);
+    if (!ready) {
+        klog('w', "No UART found at COM1");
+        return;
+    }
+
+    Interrupts::get()->setHandler(IRQ(4), serialh);
+    outb(SERIAL_COM1 + REG_IER, IER_RX);
+}
+
+void Serial::transmit() {
+    if (!(inb(SERIAL_COM1 + REG_LSR) & LSR_THRE)) {
+        // The FIFO is still draining; have it interrupt once it is empty
+        if (txTail != txHead)
+            outb(SERIAL_COM1 + REG_IER, IER_RX | IER_THRE);
+        return;
+    }
+
+    // THRE means the whole FIFO is empty
+    for (int i = 0; i < FIFO_SIZE && txTail != txHead; i++) {
+        outb(SERIAL_COM1 + REG_DATA, txBuffer[txTail % SERIAL_BUFFER_SIZE]);
+        txTail++;
+    }
+
+    outb(SERIAL_COM1 + REG_IER, IER_RX | ((txTail != txHead) ? IER_THRE : 0));
+}
+
+void Serial::handle(isrq_registers_t* r) {
+    bool received = false;
+
+    while (!(inb(SERIAL_COM1 + REG_IIR) & IIR_NONE)) {
+        while (inb(SERIAL_COM1 + REG_LSR) & LSR_RX) {
+            uint8_t c = inb(SERIAL_COM1 + REG_DATA);
+            if (rxHead - rxTail < SERIAL_BUFFER_SIZE)
+                rxBuffer[rxHead++ % SERIAL_BUFFER_SIZE] = c;
+            received = true;
+        }
+        transmit();
+    }
+
+    if (received)
+        watchers_notify(watchers);
+}
+
+uint64_t Serial::write(const void* buffer, uint64_t count) {
+    if (!ready)
+        return count;
+
+    uint64_t c = 0;
+    while (c < count && txHead - txTail < SERIAL_BUFFER_SIZE) {
+        txBuffer[txHead++ % SERIAL_BUFFER_SIZE] = ((uint8_t*)buffer)[c];
+        c++;
+    }
+    transmit();
+    return c;
+}
+
+uint64_t Serial::read(void* buffer, uint64_t count) {
+    uint64_t c = 0;
+    while (c < count && rxTail != rxHead) {
+        ((uint8_t*)buffer)[c] = rxBuffer[rxTail++ % SERIAL_BUFFER_SIZE];
+        c++;
+    }
+    return c;
+}
+
+bool Serial::canRead() {
+    return rxTail != rxHead;
+}
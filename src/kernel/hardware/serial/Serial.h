@@ -0,0 +1,30 @@
+#ifndef HARDWARE_SERIAL_SERIAL_H
+#define HARDWARE_SERIAL_SERIAL_H
+
+#include <lang/lang.h>
+#include <lang/Singleton.h>
+#include <interrupts/Interrupts.h>
+#include <fs/File.h>
+
+
+#define SERIAL_COM1 0x3f8
+#define SERIAL_BUFFER_SIZE 8192
+
+
+class Serial : public Singleton<Serial> {
+public:
+    void init();
+    void handle(isrq_registers_t*);
+    uint64_t write(const void* buffer, uint64_t count);
+    uint64_t read(void* buffer, uint64_t count);
+    bool canRead();
+    bool ready;
+    FileWatcher* watchers;
+private:
+    void transmit();
+    uint8_t txBuffer[SERIAL_BUFFER_SIZE];
+    uint8_t rxBuffer[SERIAL_BUFFER_SIZE];
+    uint64_t txHead, txTail, rxHead, rxTail;
+};
+
+#endif
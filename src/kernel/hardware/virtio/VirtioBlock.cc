@@ -0,0 +1,252 @@
+#include <hardware/virtio/VirtioBlock.h>
+#include <alloc/malloc.h>
+#include <hardware/io.h>
+#include <memory/Memory.h>
+#include <kconfig.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <kutil.h>
+
+
+#define VIRTIO_PCI_VENDOR 0x1af4
+#define VIRTIO_PCI_BLOCK 0x1001
+
+#define VIRTIO_DEVICE_FEATURES 0x00
+#define VIRTIO_GUEST_FEATURES 0x04
+#define VIRTIO_QUEUE_ADDRESS 0x08
+#define VIRTIO_QUEUE_SIZE 0x0c
+#define VIRTIO_QUEUE_SELECT 0x0e
+#define VIRTIO_QUEUE_NOTIFY 0x10
+#define VIRTIO_STATUS 0x12
+#define VIRTIO_ISR 0x13
+#define VIRTIO_CONFIG 0x14
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 1
+#define VIRTIO_STATUS_DRIVER 2
+#define VIRTIO_STATUS_DRIVER_OK 4
+#define VIRTIO_STATUS_FAILED 128
+
+#define VIRTIO_BLK_F_SEG_MAX 2
+#define VIRTIO_BLK_CONFIG_SEG_MAX 12
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+
+#define VIRTQ_DESC_F_NEXT 1
+#define VIRTQ_DESC_F_WRITE 2
+
+#define VIRTQ_ALIGN(x) (((x) + KCFG_PAGE_SIZE - 1) / KCFG_PAGE_SIZE * KCFG_PAGE_SIZE)
+
+
+// Length of the physically contiguous run at offset in r's buffer, up
+// to length bytes
+static uint64_t contiguous(block_request_t* r, uint64_t offset, uint64_t length, uint64_t* physical) {
+    *physical = block_request_physical(r, offset);
+    uint64_t run = KCFG_PAGE_SIZE - *physical % KCFG_PAGE_SIZE;
+    while (run < length && block_request_physical(r, offset + run) == *physical + run)
+        run += KCFG_PAGE_SIZE;
+    return (run < length) ? run : length;
+}
+
+
+VirtioBlock::VirtioBlock(pci_device_t* d, const char* name) : BlockDevice(name, 0) {
+    pci = d;
+    waiting = NULL;
+    lastUsed = 0;
+}
+
+int VirtioBlock::probe() {
+    int count = 0;
+    pci_device_t* d = NULL;
+    while ((d = PCI::get()->find(VIRTIO_PCI_VENDOR, VIRTIO_PCI_BLOCK, d))) {
+        char name[8];
+        snprintf(name, sizeof(name), "vd%c", 'a' + count);
+        VirtioBlock* device = new VirtioBlock(d, name);
+        if (!device->init()) {
+            klog('e', "%s: initialization failed", name);
+            continue;
+        }
+        klog('i', "%s: %lu sectors, queue size %i", name, device->sectors, device->queueSize);
+        count++;
+    }
+    return count;
+}
+
+bool VirtioBlock::init() {
+    // INTx only: without a routed line nothing would ever complete
+    if (!pci->irq || pci->irq >= 16)
+        return false;
+
+    port = PCI::get()->getBAR(pci, 0);
+    PCI::get()->enable(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+    outb(port + VIRTIO_STATUS, 0);
+    outb(port + VIRTIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(port + VIRTIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    uint32_t features = inl(port + VIRTIO_DEVICE_FEATURES) & (1 << VIRTIO_BLK_F_SEG_MAX);
+    outl(port + VIRTIO_GUEST_FEATURES, features);
+
+    outw(port + VIRTIO_QUEUE_SELECT, 0);
+    queueSize = inw(port + VIRTIO_QUEUE_SIZE);
+    if (!queueSize) {
+        outb(port + VIRTIO_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    // Legacy layout: descriptors and available ring, then the used
+    // ring on the next page boundary, all in one contiguous block
+    uint64_t usedOffset = VIRTQ_ALIGN(sizeof(virtq_desc_t) * queueSize + 6 + 2 * queueSize);
+    uint64_t ringSize = usedOffset + VIRTQ_ALIGN(6 + sizeof(virtq_used_elem_t) * queueSize);
+    uint64_t ringPhysical;
+    uint8_t* ring = (uint8_t*)Memory::allocateDMA(ringSize, &ringPhysical);
+    headers = (virtio_blk_req_t*)Memory::allocateDMA(sizeof(virtio_blk_req_t) * queueSize, &headersPhysical);
+    if (!ring || !headers) {
+        outb(port + VIRTIO_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    desc = (virtq_desc_t*)ring;
+    avail = (virtq_avail_t*)(ring + sizeof(virtq_desc_t) * queueSize);
+    used = (virtq_used_t*)(ring + usedOffset);
+    outl(port + VIRTIO_QUEUE_ADDRESS, ringPhysical / KCFG_PAGE_SIZE);
+
+    requests = (block_request_t**)kmalloc(sizeof(block_request_t*) * queueSize);
+    memset(requests, 0, sizeof(block_request_t*) * queueSize);
+    for (uint16_t i = 0; i < queueSize; i++)
+        desc[i].next = i + 1;
+    freeHead = 0;
+    freeCount = queueSize;
+
+    sectors = inl(port + VIRTIO_CONFIG) | ((uint64_t)inl(port + VIRTIO_CONFIG + 4) << 32);
+    maxChunks = queueSize - 2;
+    if (features & (1 << VIRTIO_BLK_F_SEG_MAX)) {
+        uint32_t segMax = inl(port + VIRTIO_CONFIG + VIRTIO_BLK_CONFIG_SEG_MAX);
+        if (segMax && segMax < maxChunks)
+            maxChunks = segMax;
+    }
+    queueDepth = queueSize / 2;
+    maxSegments = 16;
+
+    PCI::get()->addIRQHandler(pci, interrupt, this);
+    outb(port + VIRTIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    return true;
+}
+
+uint16_t VirtioBlock::allocate() {
+    uint16_t i = freeHead;
+    freeHead = desc[i].next;
+    freeCount--;
+    return i;
+}
+
+void VirtioBlock::release(uint16_t head) {
+    uint16_t last = head;
+    uint16_t count = 1;
+    while (desc[last].flags & VIRTQ_DESC_F_NEXT) {
+        last = desc[last].next;
+        count++;
+    }
+    desc[last].next = freeHead;
+    freeHead = head;
+    freeCount += count;
+}
+
+void VirtioBlock::dispatch(block_request_t* r) {
+    // Requests that do not fit in the ring wait for completions to
+    // free descriptors, in order
+    if (!waiting && start(r))
+        return;
+    r->next = NULL;
+    block_request_t** p = &waiting;
+    while (*p)
+        p = &(*p)->next;
+    *p = r;
+}
+
+bool VirtioBlock::start(block_request_t* r) {
+    // Header, one descriptor per physically contiguous piece of each
+    // segment, then the status byte
+    uint32_t chunks = 0;
+    for (block_request_t* s = r; s; s = s->nextSegment) {
+        uint64_t length = (uint64_t)s->count * 512;
+        for (uint64_t done = 0, physical; done < length; chunks++)
+            done += contiguous(s, done, length - done, &physical);
+    }
+    if (chunks > maxChunks) {
+        complete(r, EIO);
+        return true;
+    }
+    if (chunks + 2 > freeCount)
+        return false;
+
+    uint16_t head = allocate();
+    virtio_blk_req_t* header = &headers[head];
+    header->type = (r->op == BLOCK_READ) ? VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT;
+    header->reserved = 0;
+    header->sector = r->sector;
+    header->status = 0xff;
+    desc[head].addr = headersPhysical + head * sizeof(virtio_blk_req_t);
+    desc[head].len = 16;
+    desc[head].flags = VIRTQ_DESC_F_NEXT;
+
+    uint16_t last = head;
+    for (block_request_t* s = r; s; s = s->nextSegment) {
+        uint64_t length = (uint64_t)s->count * 512;
+        uint64_t done = 0;
+        while (done < length) {
+            uint64_t physical;
+            uint64_t c = contiguous(s, done, length - done, &physical);
+            uint16_t i = allocate();
+            desc[last].next = i;
+            desc[i].addr = physical;
+            desc[i].len = c;
+            desc[i].flags = VIRTQ_DESC_F_NEXT | ((r->op == BLOCK_READ) ? VIRTQ_DESC_F_WRITE : 0);
+            last = i;
+            done += c;
+        }
+    }
+
+    uint16_t tail = allocate();
+    desc[last].next = tail;
+    desc[tail].addr = desc[head].addr + offsetof(virtio_blk_req_t, status);
+    desc[tail].len = 1;
+    desc[tail].flags = VIRTQ_DESC_F_WRITE;
+
+    requests[head] = r;
+    avail->ring[avail->idx % queueSize] = head;
+    __sync_synchronize();
+    avail->idx++;
+    __sync_synchronize();
+    outw(port + VIRTIO_QUEUE_NOTIFY, 0);
+    return true;
+}
+
+void VirtioBlock::reap() {
+    while (lastUsed != used->idx) {
+        uint16_t head = used->ring[lastUsed % queueSize].id;
+        lastUsed++;
+
+        block_request_t* r = requests[head];
+        int status = headers[head].status ? EIO : 0;
+        requests[head] = NULL;
+        release(head);
+        complete(r, status);
+    }
+
+    while (waiting) {
+        block_request_t* r = waiting;
+        waiting = r->next;
+        if (!start(r)) {
+            r->next = waiting;
+            waiting = r;
+            break;
+        }
+    }
+}
+
+void VirtioBlock::interrupt(void* context) {
+    VirtioBlock* device = (VirtioBlock*)context;
+    if (inb(device->port + VIRTIO_ISR) & 1)
+        device->reap();
+}
@@ -0,0 +1,74 @@
+#ifndef HARDWARE_VIRTIO_VIRTIOBLOCK_H
+#define HARDWARE_VIRTIO_VIRTIOBLOCK_H
+
+#include <lang/lang.h>
+#include <block/BlockDevice.h>
+#include <hardware/pci/PCI.h>
+
+
+struct virtq_desc_t {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+struct virtq_avail_t {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed));
+
+struct virtq_used_elem_t {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed));
+
+struct virtq_used_t {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed));
+
+struct virtio_blk_req_t {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+    uint8_t status;
+    uint8_t padding[15];
+} __attribute__((packed));
+
+
+// virtio-blk through the legacy I/O port interface, with a single
+// split virtqueue. Every request in flight owns a descriptor chain
+// whose head index also picks its header and status slot
+class VirtioBlock : public BlockDevice {
+public:
+    VirtioBlock(pci_device_t* pci, const char* name);
+    // Sets up every virtio-blk on the PCI bus and returns how many
+    static int probe();
+protected:
+    virtual void dispatch(block_request_t* r);
+private:
+    bool init();
+    bool start(block_request_t* r);
+    void reap();
+    uint16_t allocate();
+    void release(uint16_t head);
+    static void interrupt(void* context);
+
+    pci_device_t* pci;
+    uint16_t port;
+    uint16_t queueSize;
+    uint32_t maxChunks;
+    virtq_desc_t* desc;
+    virtq_avail_t* avail;
+    virtq_used_t* used;
+    uint16_t freeHead, freeCount, lastUsed;
+    virtio_blk_req_t* headers;
+    uint64_t headersPhysical;
+    block_request_t** requests;
+    block_request_t* waiting;
+};
+
+#endif
@@ -1,12 +1,38 @@
-#define KCFG_LOG_FORCE_RENDER
 #define KCFG_ENABLE_TRACING
 #define KCFG_ENABLE_MEMTRACING
-#define KCFG_STRACE
-#define KCFG_STRACE2
+//#define KCFG_STRACE
+//#define KCFG_STRACE2
 //#define KCFG_WARN_SYSCALL_STUBS
 
 #define KCFG_TEMPHEAP_SIZE 819200
 
+#define KCFG_LOG_RING_SIZE 1024
+#define KCFG_LOG_LINE_SIZE 128
+#define KCFG_LOG_DRAIN_INTERVAL 20
+#define KCFG_LOG_DRAIN_BATCH 64
+
+#define KCFG_MAX_CPUS 1
+#define KCFG_TRACE_RING_SIZE 1024
+
+#define KCFG_DENTRY_CACHE_SIZE 2048
+#define KCFG_DENTRY_HASH_SIZE 1021
+#define KCFG_DENTRY_NAME_SIZE 64
+
+#define KCFG_VNODE_CACHE_PAGES 64
+#define KCFG_TMPFS_MAX_PAGES 4096
+#define KCFG_READAHEAD_MIN_PAGES 4
+#define KCFG_READAHEAD_MAX_PAGES 32
+
+#define KCFG_DIRTY_BACKGROUND_PAGES 256
+#define KCFG_DIRTY_LIMIT_PAGES 1024
+#define KCFG_DIRTY_EXPIRE_MS 30000
+#define KCFG_WRITEBACK_INTERVAL_MS 5000
+#define KCFG_WRITEBACK_BATCH_PAGES 32
+
+#define KCFG_BLOCK_READ_EXPIRE_MS 500
+#define KCFG_BLOCK_WRITE_EXPIRE_MS 5000
+#define KCFG_BLOCK_MAX_SECTORS 256
+
 #define KCFG_PAGE_SIZE 0x1000
 #define KCFG_PML4_LOCATION 0x50000
 #define KCFG_LOW_IDENTITY_PAGING_LENGTH 0xfff000
@@ -18,6 +44,8 @@
 
 #define KCFG_TEMP_PAGE_1 0xffffffffe0000000
 #define KCFG_TEMP_PAGE_2 0xffffffffe0001000
+#define KCFG_MMIO_START 0xffffffffe8000000
+#define KCFG_MMIO_SIZE  0x0000000001000000
 
 /* 
 MEMORY MAP
@@ -27,6 +55,7 @@ MEMORY MAP
 
 0xffffffffe0000000                          Temp page 1
 0xffffffffe0001000                          Temp page 2
+0xffffffffe8000000  -   0xffffffffe9000000  Device MMIO
 0xfffffffff0000000  -   0xfffffffff1000000  Kernel heap
 TOP-0x1000        -   TOP                   Aux map
 
@@ -6,7 +6,13 @@
 #include <hardware/io.h>
 #include <tty/Escape.h>
 #include <tty/PhysicalTerminalManager.h>
+#include <core/CPU.h>
 #include <core/Debug.h>
+#include <core/Scheduler.h>
+#include <core/Thread.h>
+#include <core/Wait.h>
+#include <hardware/pit/PIT.h>
+#include <hardware/serial/Serial.h>
 #include "alloc/malloc.h"
 
 
@@ -46,62 +52,141 @@ static void __output_bochs(const char* s) {
         outb(0xe9, s[c]);
 }
 
+
+static klog_record_t klog_ring[KCFG_LOG_RING_SIZE];
+static volatile uint64_t klog_head = 0;
+static uint64_t klog_drained = 1;
+
+
 void klog(char type, const char* format, ...) {
     va_list args;
-    va_start(args, format);
 
     #ifndef KCFG_ENABLE_TRACING
-        if (type == 't' || type == 'd') {
-            va_end(args);
+        if (type == 't' || type == 'd')
             return;
-        }
     #endif
 
-    if (!__logging_allowed) {
-        va_end(args);
+    if (!__logging_allowed)
         return;
-    }
 
-    static char buffer[128];
-    vsnprintf(buffer, 128, format, args);
+    uint64_t seq = __sync_add_and_fetch(&klog_head, 1);
+    klog_record_t* r = &klog_ring[seq % KCFG_LOG_RING_SIZE];
+
+    r->seq = 0; // not published yet
+    __sync_synchronize();
 
+    r->type = type;
+    r->ticks = PIT::get()->getTicks();
+    va_start(args, format);
+    vsnprintf(r->text, KCFG_LOG_LINE_SIZE, format, args);
     va_end(args);
 
-    #ifdef KCFG_ENABLE_TRACING
-        __output_bochs(buffer);
-        __output_bochs("\n");
-    #endif
+    __sync_synchronize();
+    r->seq = seq;
+}
 
-    if (type == 'd' || type == 't')
-        return;
-    
-    if (__logging_terminal_ready) {
-        Terminal* t = PhysicalTerminalManager::get()->getActiveTerminal();    
-
-        if (type == 'w') {
-            t->write(Escape::C_B_YELLOW);
-            t->write("WARN ");
-        } else if (type == 'e') {
-            t->write(Escape::C_B_RED);
-            t->write("ERROR");
-        } else if (type == 'i') {
-            t->write(Escape::C_B_WHITE);
-            t->write("INFO ");
-        } else if (type == 's') {
-            t->write(Escape::C_B_CYAN);
-            t->write("SUCC ");
-        } else {
-            t->write(Escape::C_CYAN);
-            t->write("???  ");
+bool klog_read(uint64_t* seq, klog_record_t* out) {
+    while (*seq <= klog_head) {
+        klog_record_t* r = &klog_ring[*seq % KCFG_LOG_RING_SIZE];
+        uint64_t rseq = r->seq;
+
+        if (rseq > *seq || klog_head - *seq >= KCFG_LOG_RING_SIZE) {
+            // overwritten, skip to the oldest retained record
+            *seq = (klog_head >= KCFG_LOG_RING_SIZE) ? klog_head - KCFG_LOG_RING_SIZE + 1 : 1;
+            continue;
         }
-        t->write(" :: ");
-        t->write(buffer);
-        t->write(Escape::C_OFF);
-        t->write("\n");
+        if (rseq != *seq)
+            return false; // still being written
+
+        *out = *r;
+        __sync_synchronize();
+        if (r->seq != *seq)
+            continue; // overwritten while copying
+
+        (*seq)++;
+        return true;
+    }
+    return false;
+}
+
+uint64_t klog_last_seq() {
+    return klog_head;
+}
+
+int klog_format(klog_record_t* r, char* buffer, int size) {
+    int level = 7;
+    if (r->type == 'e') level = 3;
+    if (r->type == 'w') level = 4;
+    if (r->type == 's') level = 5;
+    if (r->type == 'i') level = 6;
+
+    uint32_t freq = PIT::get()->getFrequency();
+    uint64_t ms = freq ? r->ticks * 1000 / freq : 0;
+
+    return snprintf(buffer, size, "<%i>[%5lu.%03lu] %s\n", level, ms / 1000, ms % 1000, r->text);
+}
+
+static const char* klog_label(char type) {
+    if (type == 'w') return "WARN ";
+    if (type == 'e') return "ERROR";
+    if (type == 'i') return "INFO ";
+    if (type == 's') return "SUCC ";
+    return "???  ";
+}
+
+static void klog_output_terminal(klog_record_t* r) {
+    Terminal* t = PhysicalTerminalManager::get()->getActiveTerminal();    
+
+    if (r->type == 'w')
+        t->write(Escape::C_B_YELLOW);
+    else if (r->type == 'e')
+        t->write(Escape::C_B_RED);
+    else if (r->type == 'i')
+        t->write(Escape::C_B_WHITE);
+    else if (r->type == 's')
+        t->write(Escape::C_B_CYAN);
+    else
+        t->write(Escape::C_CYAN);
+    t->write(klog_label(r->type));
+    t->write(" :: ");
+    t->write(r->text);
+    t->write(Escape::C_OFF);
+    t->write("\n");
+}
 
-        #ifdef KCFG_LOG_FORCE_RENDER
-            t->render(); // force render ASAP
+static void klog_output_serial(klog_record_t* r) {
+    Serial* s = Serial::get();
+    s->write(klog_label(r->type), 5);
+    s->write(" :: ", 4);
+    s->write(r->text, strlen(r->text));
+    s->write("\r\n", 2);
+}
+
+static void klog_drain(int limit) {
+    if (!__logging_terminal_ready)
+        return;
+
+    klog_record_t r;
+    while (limit-- && klog_read(&klog_drained, &r)) {
+        #ifdef KCFG_ENABLE_TRACING
+            __output_bochs(r.text);
+            __output_bochs("\n");
         #endif
+
+        if (r.type != 'd' && r.type != 't') {
+            klog_output_terminal(&r);
+            if (Serial::get()->ready)
+                klog_output_serial(&r);
+        }
+    }
+}
+
+void klog_daemon(void*) {
+    for (;;) {
+        Scheduler::get()->getActiveThread()->wait(new WaitForDelay(KCFG_LOG_DRAIN_INTERVAL));
+        CPU::CLI();
+        klog_drain(KCFG_LOG_DRAIN_BATCH);
+        CPU::STI();
     }
 }
 
@@ -130,6 +215,7 @@ void ktracemem(const char* file, int line) {
 }
 
 void klog_flush() {
+    klog_drain(-1);
     if (__logging_terminal_ready)
         PhysicalTerminalManager::get()->render();
 }
@@ -29,10 +29,21 @@ void __outputhex(uint64_t h, int offset);
 void __output(const char* s, int offset);
 void microtrace();
 
+struct klog_record_t {
+    uint64_t seq;
+    uint64_t ticks;
+    char type;
+    char text[KCFG_LOG_LINE_SIZE];
+};
+
 void klog_init();
 void klog_init_terminal();
 void klog(char type, const char* format, ...);
 void klog_flush();
+void klog_daemon(void*);
+bool klog_read(uint64_t* seq, klog_record_t* out);
+uint64_t klog_last_seq();
+int  klog_format(klog_record_t* r, char* buffer, int size);
 
 void dump_stack(uint64_t, uint64_t);
 
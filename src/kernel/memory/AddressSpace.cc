@@ -226,7 +226,7 @@ void AddressSpace::allocateSpace(uint64_t base, uint64_t size, uint8_t attrs) {
     top = (top + KCFG_PAGE_SIZE - 1) / KCFG_PAGE_SIZE * KCFG_PAGE_SIZE;
     size = top - base;
     #ifdef KCFG_ENABLE_TRACING
-        klog('t', "Allocating %lx bytes at %lx", size, base);klog_flush();
+        klog('t', "Allocating %lx bytes at %lx", size, base);
     #endif
     for (uint64_t v = base; v < base + size; v += KCFG_PAGE_SIZE) {
         allocatePage(getPage(v, true), attrs);
@@ -301,8 +301,11 @@ void AddressSpace::write(void* buf, uint64_t base, uint64_t size) {
 
 void AddressSpace::releasePage(page_descriptor_t page) {
     if (page.entry->present) {
-        FrameAlloc::get()->release(page.entry->address);
+        // Borrowed frames belong to someone else, e.g. the kernel heap
+        if (!PAGEATTR_IS_BORROWED(*page.attrs))
+            FrameAlloc::get()->release(page.entry->address);
         initialize_node_entry(page.entry);
+        *page.attrs = 0;
     }
 }
 
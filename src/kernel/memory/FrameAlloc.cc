@@ -19,6 +19,9 @@ void FrameAlloc::init(uint64_t total) {
 }
 
 void FrameAlloc::markAllocated(uint64_t frame) {
+    // Device memory lies above RAM and is not ours to track
+    if (frame >= totalFrames)
+        return;
     uint64_t idx = BS_IDX(frame);
     uint8_t  off = BS_OFF(frame);
     //if (Debug::tracingOn)
@@ -42,6 +45,8 @@ uint64_t FrameAlloc::allocate() {
 }
 
 void FrameAlloc::release(uint64_t frame) {
+    if (frame >= totalFrames)
+        return;
     uint64_t idx = BS_IDX(frame);
     uint8_t  off = BS_OFF(frame);
     //if (Debug::tracingOn)
@@ -6,6 +6,7 @@
 #include <memory/AddressSpace.h>
 #include <memory/FrameAlloc.h>
 #include <kutil.h>
+#include <string.h>
 
 
 Message Memory::MSG_PAGEFAULT("page-fault");
@@ -80,7 +81,64 @@ void Memory::log() {
     klog('d', "Phy frames:  %i/%i (%i/%i KB)", 
         FrameAlloc::get()->getAllocated(), FrameAlloc::get()->getTotal(),
         FrameAlloc::get()->getAllocated() * 4, FrameAlloc::get()->getTotal() * 4);   
-    klog_flush();
+}
+
+void* Memory::allocateDMA(uint64_t size, uint64_t* physical) {
+    // The heap is backed one frame at a time, so a buffer spanning
+    // pages is only usable if its frames happen to be consecutive.
+    // Misses stay allocated until a hit, so each try gets new frames
+    void* rejected[8];
+    int count = 0;
+    uint8_t* result = NULL;
+    while (!result && count < 8) {
+        uint8_t* p = (uint8_t*)kvalloc(size);
+        uint64_t base = getPhysical(p);
+        bool contiguous = true;
+        for (uint64_t o = KCFG_PAGE_SIZE; o < size; o += KCFG_PAGE_SIZE)
+            if (getPhysical(p + o) != base + o)
+                contiguous = false;
+        if (contiguous) {
+            result = p;
+            *physical = base;
+        } else
+            rejected[count++] = p;
+    }
+    for (int i = 0; i < count; i++)
+        kfree(rejected[i]);
+
+    if (result)
+        memset(result, 0, size);
+    return result;
+}
+
+uint64_t Memory::getPhysical(void* virt) {
+    return AddressSpace::current->getPhysicalAddress((uint64_t)virt);
+}
+
+void* Memory::mapMMIO(uint64_t physical, uint64_t size) {
+    static uint64_t next = KCFG_MMIO_START;
+
+    uint64_t base = PAGEALIGN(physical);
+    uint64_t top = PAGECEIL(physical + size);
+    if (next + top - base > KCFG_MMIO_START + KCFG_MMIO_SIZE)
+        return NULL;
+
+    uint64_t virt = next;
+    for (uint64_t p = base; p < top; p += KCFG_PAGE_SIZE) {
+        page_descriptor_t page = AddressSpace::kernelSpace->mapPage(
+            AddressSpace::kernelSpace->getPage(next, true),
+            p, PAGEATTR_SHARED
+        );
+        page.entry->unused |= 3; // PWT | PCD
+        next += KCFG_PAGE_SIZE;
+    }
+
+    AddressSpace::kernelSpace->namePage(
+        AddressSpace::kernelSpace->getPage(virt, false),
+        "Device MMIO"
+    );
+    AddressSpace::current->activate();
+    return (void*)(virt + physical - base);
 }
 
 void Memory::handlePageFault(isrq_registers_t* regs) {
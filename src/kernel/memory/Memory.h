@@ -13,6 +13,14 @@ public:
     static void handlePageFault(isrq_registers_t* reg);
     static void handleGPF(isrq_registers_t* reg);
     static void log();
+
+    // Memory for devices to access directly: physically contiguous,
+    // page aligned and zeroed
+    static void* allocateDMA(uint64_t size, uint64_t* physical);
+    static uint64_t getPhysical(void* virt);
+    // Uncached kernel mapping of device registers. Address spaces
+    // inherit it when cloned, so map before spawning processes
+    static void* mapMMIO(uint64_t physical, uint64_t size);
     static Message MSG_PAGEFAULT;
     static Message MSG_GPF;
 private:    
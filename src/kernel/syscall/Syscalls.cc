@@ -1,9 +1,14 @@
 #include <core/CPU.h>
 #include <core/Process.h>
 #include <core/Scheduler.h>
+#include <core/Trace.h>
 #include <elf/ELF.h>
+#include <fs/Epoll.h>
+#include <fs/IoRing.h>
 #include <fs/vfs/VFS.h>
+#include <fs/Writeback.h>
 #include <hardware/cmos/CMOS.h>
+#include <hardware/pit/PIT.h>
 #include <hardware/pm.h>
 #include <hardware/vga/VGA.h>
 #include <kutil.h>
@@ -45,13 +50,14 @@ static syscall syscalls[1024];
             regs->urip); \
     }
 #else
-    #define STRACE(format, args...) {}
+    // Syscalls are recorded by core/Trace; keep arguments referenced
+    #define STRACE(format, args...) { if (0) klog('t', format, ## args); }
 #endif
 
 #ifdef KCFG_STRACE2
     #define STRACE2 STRACE
 #else
-    #define STRACE2(format, args...) {}
+    #define STRACE2(format, args...) { if (0) klog('t', format, ## args); }
 #endif
 
 #ifdef KCFG_WARN_SYSCALL_STUBS
@@ -69,6 +75,7 @@ static bool __strace_in_progress = false;
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <stddef.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/file.h>
@@ -100,7 +107,7 @@ SYSCALL(read) {
     auto f = (StreamFile*)process->files[fd];
 
     if (f->type == FILE_STREAM) {
-        int c;
+        int c = 0;
         while (!f->isEOF() && !(c = f->read(buffer, count))) {
             CPU::STI();
             Scheduler::get()->resume();
@@ -108,6 +115,8 @@ SYSCALL(read) {
             Scheduler::get()->pause();
             CPU::CLI();
         }
+        if (c < 0)
+            return Syscalls::error();
         return c;
     } else {
         klog('w', "Bad fd type %i", f->type);
@@ -130,15 +139,29 @@ SYSCALL(write) {
 
     File* f = process->files[fd];
 
-    if (f->type == FILE_STREAM)
-        count = ((StreamFile*)f)->write(buffer, count);
-    else {
+    if (f->type != FILE_STREAM) {
         klog('w', "Bad fd type %i", f->type);
         seterr(EBADF);
         return Syscalls::error();
     }
 
-    return count;
+    auto sf = (StreamFile*)f;
+    int written = 0;
+    while (true) {
+        int c = sf->write((uint8_t*)buffer + written, count - written);
+        if (c < 0) {
+            if (!written)
+                return Syscalls::error();
+            break;
+        }
+        written += c;
+        // Only block on backpressure, e.g. a full pipe
+        if (written >= count || sf->isEOF() || sf->canWrite())
+            break;
+        WAITONE
+    }
+
+    return written;
 }
 
 
@@ -186,36 +209,22 @@ SYSCALL(stat) {
 
     STRACE("stat(%s, 0x%lx)", path, stat);
 
-    File* f = VFS::get()->open(path, O_RDONLY);
-    if (haserr()) {
-        geterr();
-        // dir?
-        Directory* d = VFS::get()->opendir(path);
-        if (haserr())
-            return Syscalls::error();
+    if (VFS::get()->stat(path, stat) < 0)
+        return Syscalls::error();
+    return 0;
+}
 
-        d->stat(stat);
-        if (haserr()) {
-            d->close();
-            delete d;
-            return Syscalls::error();
-        }
 
-        d->close();
-        delete d;
-        return 0;    
-    }
+SYSCALL(lstat) {
+    PROCESS
+    RESOLVE_PATH(path, regs->rdi)
 
-    f->stat(stat);
-    if (haserr()) {
-        f->close();
-        delete f;
-        return Syscalls::error();
-    }
+    auto stat = (struct stat*)regs->rsi;    
 
-    f->close();
+    STRACE("lstat(%s, 0x%lx)", path, stat);
 
-    delete f;
+    if (VFS::get()->lstat(path, stat) < 0)
+        return Syscalls::error();
     return 0;
 }
 
@@ -236,32 +245,182 @@ SYSCALL(fstat) {
 
 SYSCALL(poll) {
     PROCESS
+    THREAD
   
     auto fds = (struct pollfd*)regs->rdi;    
-    auto nfds = regs->rsi;
-    auto timeout = regs->rdx;    
+    auto nfds = (int)regs->rsi;
+    auto timeout = (int)regs->rdx;    
 
     STRACE("poll(0x%lx, %i, %i)", fds, nfds, timeout);
 
+    // The wait is evaluated by the scheduler from other address spaces,
+    // so it gets kernel copies of the files and event masks
+    auto files = new StreamFile*[nfds];
+    auto events = new short[nfds];
+    uint64_t started = PIT::get()->getTime();
+    int ready;
+
     while (true) {
-        for (uint i = 0; i < nfds; i++) {
-            auto f = (StreamFile*)process->files[fds[i].fd];
-
-            if (f->type == FILE_STREAM) {
-                if (f->canRead()) {
-                    fds[i].revents = POLLIN;
-                    return 1;
-                }
+        ready = 0;
+        for (int i = 0; i < nfds; i++) {
+            files[i] = NULL;
+            events[i] = fds[i].events;
+            fds[i].revents = 0;
+            if (fds[i].fd < 0)
+                continue;
+
+            File* f = process->files[fds[i].fd];
+            if (!f) {
+                fds[i].revents = POLLNVAL;
+                ready++;
+                continue;
             }
+            if (f->type != FILE_STREAM)
+                continue;
+
+            auto sf = (StreamFile*)f;
+            files[i] = sf;
+            if (sf->isEOF())
+                fds[i].revents |= POLLHUP;
+            if ((events[i] & POLLIN) && sf->canRead())
+                fds[i].revents |= POLLIN;
+            if ((events[i] & POLLOUT) && sf->canWrite())
+                fds[i].revents |= POLLOUT;
+            if (fds[i].revents)
+                ready++;
         }
 
-        WAITONE
+        if (ready || timeout == 0)
+            break;
+
+        int64_t remaining = -1;
+        if (timeout > 0) {
+            remaining = timeout - (int64_t)(PIT::get()->getTime() - started);
+            if (remaining <= 0)
+                break;
+        }
+
+        thread->wait(new WaitForPoll(files, events, nfds, remaining));
+        WAIT
+        Scheduler::get()->pause();
+        CPU::CLI();
+    }
+
+    delete[] files;
+    delete[] events;
+    return ready;
+}
+
+
+SYSCALL(epoll_create1) {
+    PROCESS
+
+    auto flags = regs->rdi;
+
+    STRACE("epoll_create1(0x%x)", flags);
+
+    return process->attachFile(new Epoll());
+}
+
+
+SYSCALL(epoll_create) {
+    auto size = (int)regs->rdi;
+
+    STRACE("epoll_create(%i)", size);
+
+    if (size <= 0) {
+        seterr(EINVAL);
+        return Syscalls::error();
     }
+    regs->rdi = 0;
+    return sys_epoll_create1(regs);
+}
+
+
+SYSCALL(epoll_ctl) {
+    PROCESS
+
+    auto epfd = (int)regs->rdi;
+    auto op = (int)regs->rsi;
+    auto fd = (int)regs->rdx;
+    auto event = (struct epoll_event*)regs->r10;
 
+    STRACE("epoll_ctl(%i, %i, %i, 0x%lx)", epfd, op, fd, event);
+
+    File* ef = process->files[epfd];
+    File* f = process->files[fd];
+    if (!ef || !f) {
+        seterr(EBADF);
+        return Syscalls::error();
+    }
+    if (ef->type != FILE_EPOLL || f->type != FILE_STREAM || ef == f) {
+        seterr(EINVAL);
+        return Syscalls::error();
+    }
+
+    auto epoll = (Epoll*)ef;
+    int result;
+    if (op == EPOLL_CTL_ADD)
+        result = epoll->add(fd, (StreamFile*)f, event);
+    else if (op == EPOLL_CTL_MOD)
+        result = epoll->modify(fd, event);
+    else if (op == EPOLL_CTL_DEL)
+        result = epoll->remove(fd);
+    else {
+        seterr(EINVAL);
+        return Syscalls::error();
+    }
+
+    if (result < 0)
+        return Syscalls::error();
     return 0;
 }
 
 
+SYSCALL(epoll_wait) {
+    PROCESS
+    THREAD
+
+    auto epfd = (int)regs->rdi;
+    auto events = (struct epoll_event*)regs->rsi;
+    auto maxevents = (int)regs->rdx;
+    auto timeout = (int)regs->r10;
+
+    STRACE("epoll_wait(%i, 0x%lx, %i, %i)", epfd, events, maxevents, timeout);
+
+    File* f = process->files[epfd];
+    if (!f) {
+        seterr(EBADF);
+        return Syscalls::error();
+    }
+    if (f->type != FILE_EPOLL || maxevents <= 0) {
+        seterr(EINVAL);
+        return Syscalls::error();
+    }
+
+    auto epoll = (Epoll*)f;
+    uint64_t started = PIT::get()->getTime();
+
+    while (true) {
+        int n = epoll->collect(events, maxevents);
+        if (n || timeout == 0)
+            return n;
+
+        int64_t remaining = -1;
+        if (timeout > 0) {
+            remaining = timeout - (int64_t)(PIT::get()->getTime() - started);
+            if (remaining <= 0)
+                return 0;
+        }
+
+        thread->wait(new WaitForEpoll(epoll, remaining));
+        WAIT
+        Scheduler::get()->pause();
+        CPU::CLI();
+    }
+}
+
+
 SYSCALL(lseek) {
     PROCESS
   
@@ -275,7 +434,17 @@ SYSCALL(lseek) {
 
     if (f->type == FILE_STREAM)
         return ((StreamFile*)f)->seek(offset, whence);
-    else {
+    else if (f->type == FILE_DIRECTORY) {
+        // Offsets on directories are the d_off cookies from getdents64,
+        // which can only be set or read back
+        if (whence == SEEK_SET)
+            ((Directory*)f)->seek(offset);
+        else if (whence != SEEK_CUR) {
+            seterr(EINVAL);
+            return Syscalls::error();
+        }
+        return ((Directory*)f)->position;
+    } else {
         klog('w', "Bad fd type %i", f->type);
         seterr(EBADF);
         return Syscalls::error();
@@ -298,6 +467,20 @@ SYSCALL(mmap) {
 
     STRACE2("mmap(0x%lx, 0x%lx, %i, %i, %i, 0x%lx)", addr, length, prot, flags, fd, offset);
 
+    if (!(flags & MAP_ANONYMOUS) && (int)fd >= 0 && (int)fd < process->files.capacity
+        && process->files[fd] && process->files[fd]->type == FILE_IORING) {
+        // Only the ring's creator maps it, see io_uring_enter
+        auto ring = (IoRing*)process->files[fd];
+        if (ring->process != process) {
+            seterr(EINVAL);
+            return Syscalls::error();
+        }
+        uint64_t mapping = ring->map(offset, length);
+        if (!mapping)
+            return Syscalls::error();
+        return mapping;
+    }
+
     if (length > 0x100000) { // uClibc, U MAD?
         length = 0x80000;
     }
@@ -465,26 +648,366 @@ SYSCALL(ioctl) {
 }
 
 
+static StreamFile* stream_fd(Process* process, int fd) {
+    File* f = (fd >= 0 && fd < process->files.capacity) ? process->files[fd] : NULL;
+    if (!f) {
+        seterr(EBADF);
+        return NULL;
+    }
+    if (f->type != FILE_STREAM) {
+        seterr(f->type == FILE_DIRECTORY ? EISDIR : EINVAL);
+        return NULL;
+    }
+    return (StreamFile*)f;
+}
+
+
+SYSCALL(readv) {
+    PROCESS
+ 
+    auto fd = regs->rdi;    
+    auto iov = (const struct iovec*)regs->rsi;
+    auto iovcnt = (int)regs->rdx;
+
+    STRACE2("readv(%i, 0x%lx, %i)", fd, iov, iovcnt);
+
+    auto f = stream_fd(process, fd);
+    if (!f)
+        return Syscalls::error();
+
+    // Nothing to fill: a 0 from readv() would mean "no data yet" and
+    // the loop below would never end
+    uint64_t length = 0;
+    for (int i = 0; i < iovcnt; i++)
+        length += iov[i].iov_len;
+    if (!length)
+        return 0;
+
+    int64_t c = 0;
+    while (!f->isEOF() && !(c = f->readv(iov, iovcnt))) {
+        CPU::STI();
+        Scheduler::get()->resume();
+        CPU::halt();
+        Scheduler::get()->pause();
+        CPU::CLI();
+    }
+    if (c < 0)
+        return Syscalls::error();
+    return c;
+}
+
+
 SYSCALL(writev) {
     PROCESS
  
     auto fd = regs->rdi;    
-    auto iov = (uint64_t)regs->rsi;
-    auto iovcnt = regs->rdx;
+    auto iov = (const struct iovec*)regs->rsi;
+    auto iovcnt = (int)regs->rdx;
 
-    STRACE("writev(%i, 0x%x, %i)", fd, iov, iovcnt);
+    STRACE2("writev(%i, 0x%lx, %i)", fd, iov, iovcnt);
 
-    File* file = process->files[fd];
+    auto f = stream_fd(process, fd);
+    if (!f)
+        return Syscalls::error();
 
-    uint64_t written = 0;
+    return f->writev(iov, iovcnt);
+}
+
+
+SYSCALL(pread64) {
+    PROCESS
+ 
+    auto fd = regs->rdi;    
+    auto buffer = (void*)regs->rsi;
+    auto count = regs->rdx;
+    auto offset = regs->r10;
+
+    STRACE2("pread64(%i, 0x%lx, %i, %li)", fd, buffer, count, offset);
+
+    auto f = stream_fd(process, fd);
+    if (!f)
+        return Syscalls::error();
+
+    struct iovec iov = { buffer, count };
+    int64_t c = f->preadv(&iov, 1, offset);
+    if (c < 0)
+        return Syscalls::error();
+    return c;
+}
+
+
+SYSCALL(pwrite64) {
+    PROCESS
+ 
+    auto fd = regs->rdi;    
+    auto buffer = (void*)regs->rsi;
+    auto count = regs->rdx;
+    auto offset = regs->r10;
+
+    STRACE2("pwrite64(%i, 0x%lx, %i, %li)", fd, buffer, count, offset);
 
-    for (uint64_t i = 0; i < iovcnt; i++) {
-        auto vector = (struct iovec*)(iov + i * sizeof(iovec));
-        ((StreamFile*)file)->write(vector->iov_base, vector->iov_len);
-        written += vector->iov_len;
+    auto f = stream_fd(process, fd);
+    if (!f)
+        return Syscalls::error();
+
+    struct iovec iov = { buffer, count };
+    int64_t c = f->pwritev(&iov, 1, offset);
+    if (c < 0)
+        return Syscalls::error();
+    return c;
+}
+
+
+SYSCALL(preadv) {
+    PROCESS
+ 
+    auto fd = regs->rdi;    
+    auto iov = (const struct iovec*)regs->rsi;
+    auto iovcnt = (int)regs->rdx;
+    auto offset = regs->r10;
+
+    STRACE2("preadv(%i, 0x%lx, %i, %li)", fd, iov, iovcnt, offset);
+
+    auto f = stream_fd(process, fd);
+    if (!f)
+        return Syscalls::error();
+
+    int64_t c = f->preadv(iov, iovcnt, offset);
+    if (c < 0)
+        return Syscalls::error();
+    return c;
+}
+
+
+SYSCALL(pwritev) {
+    PROCESS
+ 
+    auto fd = regs->rdi;    
+    auto iov = (const struct iovec*)regs->rsi;
+    auto iovcnt = (int)regs->rdx;
+    auto offset = regs->r10;
+
+    STRACE2("pwritev(%i, 0x%lx, %i, %li)", fd, iov, iovcnt, offset);
+
+    auto f = stream_fd(process, fd);
+    if (!f)
+        return Syscalls::error();
+
+    int64_t c = f->pwritev(iov, iovcnt, offset);
+    if (c < 0)
+        return Syscalls::error();
+    return c;
+}
+
+
+#ifndef SPLICE_F_NONBLOCK
+#define SPLICE_F_NONBLOCK 2
+#endif
+
+static int64_t splice_files(StreamFile* in, uint64_t* offIn, StreamFile* out, uint64_t* offOut, uint64_t count, bool nonblock) {
+    Pipe* inPipe = in->getPipe(false);
+    Pipe* outPipe = out->getPipe(true);
+
+    if ((inPipe && offIn) || (outPipe && offOut)) {
+        seterr(ESPIPE);
+        return -1;
+    }
+    if ((!inPipe && !outPipe) || inPipe == outPipe) {
+        seterr(EINVAL);
+        return -1;
     }
 
-    return written;
+    while (inPipe && !inPipe->canRead() && !inPipe->isEOF()) {
+        if (nonblock) {
+            seterr(EAGAIN);
+            return -1;
+        }
+        WAITONE
+    }
+    while (outPipe && !outPipe->canWrite()) {
+        if (nonblock) {
+            seterr(EAGAIN);
+            return -1;
+        }
+        WAITONE
+    }
+
+    if (inPipe && outPipe)
+        return inPipe->spliceTo(outPipe, count);
+    if (inPipe)
+        return inPipe->spliceTo(out, count, offOut);
+    return outPipe->spliceFrom(in, count, offIn);
+}
+
+
+SYSCALL(sendfile) {
+    PROCESS
+
+    auto outfd = regs->rdi;
+    auto infd = regs->rsi;
+    auto offset = (off_t*)regs->rdx;
+    auto count = regs->r10;
+
+    STRACE("sendfile(%i, %i, 0x%lx, %li)", outfd, infd, offset, count);
+
+    auto in = stream_fd(process, infd);
+    auto out = stream_fd(process, outfd);
+    if (!in || !out)
+        return Syscalls::error();
+
+    uint64_t off = offset ? *offset : 0;
+    uint64_t* poff = offset ? &off : NULL;
+    int64_t total = 0;
+
+    if (in->getPipe(false) || out->getPipe(true)) {
+        total = splice_files(in, poff, out, NULL, count, false);
+        if (total < 0)
+            return Syscalls::error();
+    } else {
+        // Neither side is a pipe: stage the data in pipe pages, which
+        // still keeps it out of user space
+        auto staging = new Pipe();
+        while ((uint64_t)total < count) {
+            int64_t got = staging->spliceFrom(in, count - total, poff);
+            if (got <= 0)
+                break;
+            int64_t put = staging->spliceTo(out, got, NULL);
+            if (put > 0)
+                total += put;
+            if (put < got) {
+                if (poff)
+                    off -= got - (put > 0 ? put : 0);
+                break;
+            }
+        }
+        staging->close();
+        delete staging;
+    }
+
+    if (offset)
+        *offset = off;
+    return total;
+}
+
+
+SYSCALL(splice) {
+    PROCESS
+
+    auto infd = regs->rdi;
+    auto inoff = (loff_t*)regs->rsi;
+    auto outfd = regs->rdx;
+    auto outoff = (loff_t*)regs->r10;
+    auto count = regs->r8;
+    auto flags = regs->r9;
+
+    STRACE("splice(%i, 0x%lx, %i, 0x%lx, %li, 0x%x)", infd, inoff, outfd, outoff, count, flags);
+
+    auto in = stream_fd(process, infd);
+    auto out = stream_fd(process, outfd);
+    if (!in || !out)
+        return Syscalls::error();
+
+    uint64_t offIn = inoff ? *inoff : 0;
+    uint64_t offOut = outoff ? *outoff : 0;
+
+    int64_t c = splice_files(in, inoff ? &offIn : NULL, out, outoff ? &offOut : NULL, count, flags & SPLICE_F_NONBLOCK);
+    if (c < 0)
+        return Syscalls::error();
+
+    if (inoff)
+        *inoff = offIn;
+    if (outoff)
+        *outoff = offOut;
+    return c;
+}
+
+
+SYSCALL(tee) {
+    PROCESS
+
+    auto infd = regs->rdi;
+    auto outfd = regs->rsi;
+    auto count = regs->rdx;
+    auto flags = regs->r10;
+
+    STRACE("tee(%i, %i, %li, 0x%x)", infd, outfd, count, flags);
+
+    auto in = stream_fd(process, infd);
+    auto out = stream_fd(process, outfd);
+    if (!in || !out)
+        return Syscalls::error();
+
+    Pipe* inPipe = in->getPipe(false);
+    Pipe* outPipe = out->getPipe(true);
+    if (!inPipe || !outPipe || inPipe == outPipe) {
+        seterr(EINVAL);
+        return Syscalls::error();
+    }
+
+    while (!inPipe->canRead() && !inPipe->isEOF()) {
+        if (flags & SPLICE_F_NONBLOCK) {
+            seterr(EAGAIN);
+            return Syscalls::error();
+        }
+        WAITONE
+    }
+
+    return inPipe->tee(outPipe, count);
+}
+
+
+SYSCALL(io_uring_setup) {
+    PROCESS
+
+    auto entries = (uint32_t)regs->rdi;
+    auto params = (struct io_uring_params*)regs->rsi;
+
+    STRACE("io_uring_setup(%u, 0x%lx)", entries, params);
+
+    auto ring = new IoRing(process);
+    if (!ring->setup(entries, params)) {
+        ring->close();
+        delete ring;
+        return Syscalls::error();
+    }
+    return process->attachFile(ring);
+}
+
+
+SYSCALL(io_uring_enter) {
+    PROCESS
+    THREAD
+
+    auto fd = (int)regs->rdi;
+    auto toSubmit = (uint32_t)regs->rsi;
+    auto minComplete = (uint32_t)regs->rdx;
+    auto flags = (uint32_t)regs->r10;
+
+    STRACE2("io_uring_enter(%i, %u, %u, 0x%x)", fd, toSubmit, minComplete, flags);
+
+    File* f = (fd >= 0 && fd < process->files.capacity) ? process->files[fd] : NULL;
+    if (!f || f->type != FILE_IORING) {
+        seterr(EBADF);
+        return Syscalls::error();
+    }
+
+    // Submissions run in the address space of the ring's creator
+    auto ring = (IoRing*)f;
+    if (ring->process != process) {
+        seterr(EINVAL);
+        return Syscalls::error();
+    }
+
+    uint32_t submitted = ring->submit(toSubmit);
+
+    if ((flags & IORING_ENTER_GETEVENTS) && minComplete && ring->completions() < minComplete) {
+        thread->wait(new WaitForIoCompletion(ring, minComplete));
+        WAIT
+        Scheduler::get()->pause();
+        CPU::CLI();
+    }
+
+    return submitted;
 }
 
 
@@ -659,6 +1182,12 @@ SYSCALL(execve) {
     elf->loadFromFile(path);
 
     if (!haserr()) {
+        // Rings stay open across exec, but the old image's mappings of
+        // them go away with it
+        for (int i = 0; i < process->files.capacity; i++)
+            if (process->files[i] && process->files[i]->type == FILE_IORING
+                && ((IoRing*)process->files[i])->process == process)
+                ((IoRing*)process->files[i])->unmap();
         strcpy(process->name, (char*)regs->rdi);
         elf->loadIntoProcess(process);
         elf->startMainThread(process, n_argv, n_envp);  
@@ -844,14 +1373,31 @@ SYSCALL(flock) {
 
 
 SYSCALL(fsync) {
+    PROCESS
+
     auto fd = regs->rdi;    
 
     STRACE("fsync(%u)", fd);
-    WARN_STUB("fsync");
+
+    File* f = (fd < (uint64_t)process->files.capacity) ? process->files[fd] : NULL;
+    if (!f) {
+        seterr(EBADF);
+        return Syscalls::error();
+    }
+    if (f->sync() < 0)
+        return Syscalls::error();
     return 0;
 }
 
 
+SYSCALL(fdatasync) {
+    STRACE("fdatasync(%u)", regs->rdi);
+    // The only metadata FAT keeps besides what's needed to read the
+    // data back is timestamps, so there is nothing to skip
+    return sys_fsync(regs);
+}
+
+
 SYSCALL(getcwd) {
     PROCESS
     
@@ -897,6 +1443,21 @@ SYSCALL(rename) {
 }
 
 
+SYSCALL(mkdir) {
+    PROCESS
+    RESOLVE_PATH(path, regs->rdi)
+    auto mode = regs->rsi;
+    
+    STRACE("mkdir(%s, 0%o)", path, mode);
+
+    VFS::get()->mkdir(path, mode);
+    if (haserr())
+        return Syscalls::error();
+
+    return 0;
+}
+
+
 SYSCALL(unlink) {
     PROCESS
     RESOLVE_PATH(path, regs->rdi)
@@ -911,6 +1472,20 @@ SYSCALL(unlink) {
 }
 
 
+SYSCALL(rmdir) {
+    PROCESS
+    RESOLVE_PATH(path, regs->rdi)
+    
+    STRACE("rmdir(%s)", path);
+
+    VFS::get()->rmdir(path);
+    if (haserr())
+        return Syscalls::error();
+
+    return 0;
+}
+
+
 SYSCALL(readlink) {
     PROCESS
     RESOLVE_PATH(path, regs->rdi)
@@ -961,6 +1536,52 @@ SYSCALL(sysinfo) {
 }
 
 
+SYSCALL(syslog) {
+    auto type = regs->rdi;
+    auto buf = (char*)regs->rsi;
+    auto len = (int)regs->rdx;
+
+    STRACE("syslog(%i, 0x%lx, %i)", type, buf, len);
+
+    static uint64_t readSeq = 1, clearSeq = 1;
+
+    if (type == 2 || type == 3 || type == 4) { // READ, READ_ALL, READ_CLEAR
+        uint64_t seq = (type == 2) ? readSeq : clearSeq;
+        int used = 0;
+
+        while (true) {
+            klog_record_t r;
+            char line[KCFG_LOG_LINE_SIZE + 32];
+            uint64_t next = seq;
+            if (!klog_read(&next, &r))
+                break;
+            int c = klog_format(&r, line, sizeof(line));
+            if (used + c > len)
+                break;
+            memcpy(buf + used, line, c);
+            used += c;
+            seq = next;
+        }
+
+        if (type == 2)
+            readSeq = seq;
+        if (type == 4)
+            clearSeq = seq;
+        return used;
+    }
+
+    if (type == 5) { // CLEAR
+        clearSeq = klog_last_seq() + 1;
+        return 0;
+    }
+
+    if (type == 10) // SIZE_BUFFER
+        return KCFG_LOG_RING_SIZE * (KCFG_LOG_LINE_SIZE + 32);
+
+    return 0;
+}
+
+
 SYSCALL(getuid) {
     STRACE("getuid()");
     return 0;
@@ -1029,7 +1650,7 @@ SYSCALL(arch_prctl) {
 
 SYSCALL(sync) {
     STRACE("sync()");
-    WARN_STUB("sync()")
+    Writeback::get()->sync();
     return 0;
 }
 
@@ -1078,34 +1699,48 @@ SYSCALL(getdents64) {
     PROCESS
  
     auto fd = regs->rdi;    
-    auto buf = (struct kernel_dirent64*)regs->rsi;
-    auto sz = regs->rdx; // TODO take in account
+    auto buf = (uint8_t*)regs->rsi;
+    auto sz = regs->rdx;
 
     STRACE("getdents64(%u, 0x%lx, %u)", fd, buf, sz);
 
-    auto dir = (Directory*)process->files[fd];
-    uint64_t count = 0, num = 0;
+    File* f = process->files[fd];
+    if (!f) {
+        seterr(EBADF);
+        return Syscalls::error();
+    }
+    if (f->type != FILE_DIRECTORY) {
+        seterr(ENOTDIR);
+        return Syscalls::error();
+    }
 
+    // Pack as many records as fit; an entry that does not fit stays
+    // pending in the directory for the next call
+    auto dir = (Directory*)f;
+    uint64_t used = 0;
     dirent* de;
-    while ((de = dir->read())) {
-        num++;
-        buf->d_ino = de->d_ino + 5;
-        buf->d_reclen = 256;// strlen(de->d_name) + 2;
-
-        if ((count + buf->d_reclen) > sz)
-            return num;
-
-        buf->d_off = (count += buf->d_reclen);
-        strcpy(buf->d_name, de->d_name);
-        ///*(char*)(buf + buf->d_reclen - 1) = de->d_type;
-        buf->d_type = de->d_type;
-        buf += buf->d_reclen;
-        
-        return 1;
-        //return count;
+    while ((de = dir->peek())) {
+        uint64_t length = strlen(de->d_name);
+        uint64_t reclen = (offsetof(struct kernel_dirent64, d_name) + length + 1 + 7) & ~7;
+        if (used + reclen > sz) {
+            if (!used) {
+                seterr(EINVAL);
+                return Syscalls::error();
+            }
+            break;
+        }
+
+        auto record = (struct kernel_dirent64*)(buf + used);
+        record->d_ino = de->d_ino + 5;
+        record->d_reclen = reclen;
+        record->d_type = de->d_type;
+        memcpy(record->d_name, de->d_name, length + 1);
+        dir->advance();
+        record->d_off = dir->position;
+        used += reclen;
     }
 
-    return num;
+    return used;
 }
 
 
@@ -1151,7 +1786,7 @@ void Syscalls::init() {
     syscalls[0x03] = sys_close;
     syscalls[0x04] = sys_stat;
     syscalls[0x05] = sys_fstat;
-    syscalls[0x06] = sys_stat; // lstat
+    syscalls[0x06] = sys_lstat;
     syscalls[0x07] = sys_poll;
     syscalls[0x08] = sys_lseek;
     syscalls[0x09] = sys_mmap;
@@ -1160,6 +1795,9 @@ void Syscalls::init() {
     syscalls[0x0d] = sys_rt_sigaction;
     syscalls[0x0e] = sys_sigprocmask;
     syscalls[0x10] = sys_ioctl;
+    syscalls[0x11] = sys_pread64;
+    syscalls[0x12] = sys_pwrite64;
+    syscalls[0x13] = sys_readv;
     syscalls[0x14] = sys_writev;
     syscalls[0x15] = sys_access;
     syscalls[0x16] = sys_pipe;
@@ -1167,6 +1805,7 @@ void Syscalls::init() {
     syscalls[0x21] = sys_dup2;
     syscalls[0x23] = sys_nanosleep;
     syscalls[0x27] = sys_getpid;
+    syscalls[0x28] = sys_sendfile;
     syscalls[0x39] = sys_fork;
     syscalls[0x3a] = sys_vfork;
     syscalls[0x3b] = sys_execve;
@@ -1177,14 +1816,18 @@ void Syscalls::init() {
     syscalls[0x48] = sys_fcntl;
     syscalls[0x49] = sys_flock;
     syscalls[0x4a] = sys_fsync;
+    syscalls[0x4b] = sys_fdatasync;
     syscalls[0x4f] = sys_getcwd;
     syscalls[0x50] = sys_chdir;
     syscalls[0x52] = sys_rename;
+    syscalls[0x53] = sys_mkdir;
+    syscalls[0x54] = sys_rmdir;
     syscalls[0x57] = sys_unlink;
     syscalls[0x59] = sys_readlink;
     syscalls[0x60] = sys_gettimeofday;
     syscalls[0x63] = sys_sysinfo;
     syscalls[0x66] = sys_getuid;
+    syscalls[0x67] = sys_syslog;
     syscalls[0x68] = sys_getuid; // getgid
     syscalls[0x69] = sys_setuid;
     syscalls[0x6b] = sys_getuid; // geteuid
@@ -1195,9 +1838,20 @@ void Syscalls::init() {
     syscalls[0xa2] = sys_sync;
     syscalls[0xa9] = sys_reboot;
     syscalls[0xc9] = sys_time;
+    syscalls[0xd5] = sys_epoll_create;
     syscalls[0xd9] = sys_getdents64;
+    syscalls[0xe8] = sys_epoll_wait;
+    syscalls[0xe9] = sys_epoll_ctl;
     syscalls[0xeb] = sys_utimes;
     syscalls[0x6e] = sys_getppid;
+    syscalls[0x119] = sys_epoll_wait; // epoll_pwait, sigmask ignored
+    syscalls[0x113] = sys_splice;
+    syscalls[0x114] = sys_tee;
+    syscalls[0x123] = sys_epoll_create1;
+    syscalls[0x127] = sys_preadv;
+    syscalls[0x128] = sys_pwritev;
+    syscalls[0x1a9] = sys_io_uring_setup;
+    syscalls[0x1aa] = sys_io_uring_enter;
 }
 
 
@@ -1207,6 +1861,12 @@ extern "C" uint64_t _syscall_handler(syscall_regs_t* regs) {
     Scheduler::get()->pause();
     geterr(); // drop errors
 
+    uint64_t traceSeq = 0;
+    if (Trace::enabled) {
+        uint64_t args[6] = { regs->rdi, regs->rsi, regs->rdx, regs->r10, regs->r8, regs->r9 };
+        traceSeq = Trace::syscallEnter(regs->id, args);
+    }
+
     if (syscalls[regs->id]) {
         __strace_in_progress = false;
         result = syscalls[regs->id](regs);
@@ -1219,6 +1879,9 @@ extern "C" uint64_t _syscall_handler(syscall_regs_t* regs) {
         result = -ENOSYS;
     }
 
+    if (traceSeq)
+        Trace::syscallExit(traceSeq, result);
+
     Scheduler::get()->resume();
 
     return result;
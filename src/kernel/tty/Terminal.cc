@@ -50,13 +50,31 @@ static char keymap_shifted[] = {
     0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , // 0xf0 - 0xff
 };
 
+uint8_t COLORMAP[16] = {
+    0, 4, 2, 6, 1, 5, 3, 7,
+    8,12,10,14, 9,13,11,15,
+};
+
+// VGA attribute byte for every possible RoteCell attribute
+static uint8_t ATTRMAP[256];
+static bool attrmapReady = false;
+
+
 Terminal::Terminal(int w, int h) {
     width = w;
     height = h;
     dirty = true;
+    cursorX = cursorY = -1;
     terminal = rote_vt_create(h, w);
     terminal->curattr = 0x70;
+    shadow = new uint16_t[w * h];
     pty = NULL;
+
+    if (!attrmapReady) {
+        for (int a = 0; a < 256; a++)
+            ATTRMAP[a] = (COLORMAP[ROTE_ATTR_BG(a)] << 4) + COLORMAP[ROTE_ATTR_XFG(a)];
+        attrmapReady = true;
+    }
 }
 
 
@@ -72,11 +90,6 @@ void Terminal::makeDirty() {
     dirty = true;
 }
 
-uint8_t COLORMAP[16] = {
-    0, 4, 2, 6, 1, 5, 3, 7,
-    8,12,10,14, 9,13,11,15,
-};
-
 void Terminal::render() {
     if (pty) {
         char buffer[1024];
@@ -85,28 +98,33 @@ void Terminal::render() {
         }
     }
 
-    unsigned char *vram = (unsigned char *)0xb8000;
-    uint8_t* cell = vram;
+    volatile uint16_t* vram = (volatile uint16_t*)0xb8000;
     for (int y = 0; y < height; y++) {
-        if (0 && !(terminal->line_dirty[y]) && !dirty) {
-            cell += width * 2;
+        if (!terminal->line_dirty[y] && !dirty)
             continue;
-        }
         terminal->line_dirty[y] = false;
+
+        RoteCell* row = terminal->cells[y];
+        uint16_t* shadowRow = shadow + y * width;
+        volatile uint16_t* vramRow = vram + y * width;
         for (int x = 0; x < width; x++) {
-            *(cell++) = terminal->cells[y][x].ch;
-            
-            uint8_t attr = 0;
-            uint8_t rote_attr = terminal->cells[y][x].attr;
-            attr += COLORMAP[ROTE_ATTR_BG(rote_attr)] << 4;
-            attr += COLORMAP[ROTE_ATTR_XFG(rote_attr)];
-
-            *(cell++) = attr;
+            uint16_t cell = row[x].ch | (ATTRMAP[row[x].attr] << 8);
+            if (dirty || cell != shadowRow[x]) {
+                shadowRow[x] = cell;
+                vramRow[x] = cell;
+            }
+        }
+    }
+
+    if (dirty || terminal->curpos_dirty) {
+        terminal->curpos_dirty = false;
+        if (dirty || terminal->ccol != cursorX || terminal->crow != cursorY) {
+            cursorX = terminal->ccol;
+            cursorY = terminal->crow;
+            VGA::moveCursor(cursorX, cursorY);
         }
     }
 
-    VGA::moveCursor(terminal->ccol, terminal->crow);
-    
     dirty = false;
 }
 
@@ -17,7 +17,9 @@ public:
     PTYMaster* pty;
 private:
     int         width, height;
+    int         cursorX, cursorY;
     bool        dirty;
     RoteTerm*   terminal;
+    uint16_t*   shadow;
 };
 #endif